@@ -0,0 +1,82 @@
+// Null-skipping aggregations over an optional<double> column, in GB/s
+// of column (values and bitmap) read, for each thread count up to the
+// hardware's.
+//   aggregate_bench [rows] [density]
+#include <optional_aggregate.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+namespace {
+  volatile double sink;
+
+  //! Best of a few runs, in seconds
+  template<class F>
+  double best_time(F && f)
+  {
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run)
+    {
+      auto start = std::chrono::steady_clock::now();
+      sink = f();
+      std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+      best = std::min(best, took.count());
+    }
+    return best;
+  }
+
+  void report(const char * name, unsigned threads, double bytes, double seconds)
+  {
+    double gbs = bytes / seconds / 1e9;
+    std::printf("%-6s %7u %10.2f GB/s %10.2f GB/s\n", name, threads, gbs, gbs / threads);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+  double density = argc > 2 ? std::atof(argv[2]) : 0.5;
+
+#if defined(__AVX512F__)
+  const char * isa = "avx512";
+#elif defined(__AVX2__)
+  const char * isa = "avx2";
+#else
+  const char * isa = "scalar";
+#endif
+  std::printf("%zu rows, density %.2f, %s kernels\n", rows, density, isa);
+  std::printf("%-6s %7s %15s %15s\n", "", "threads", "total", "per core");
+
+  std::mt19937_64 rng(1);
+  std::bernoulli_distribution engaged(density);
+  std::uniform_real_distribution<double> value(-1, 1);
+  std::optional_vector<double> column;
+  column.reserve(rows);
+  for (std::size_t i = 0; i != rows; ++i)
+  {
+    if (engaged(rng))
+    {
+      column.push_back(value(rng));
+    }
+    else
+    {
+      column.push_back(std::nullopt);
+    }
+  }
+
+  const double bytes = rows * sizeof(double) + detail::bitmap_words(rows) * sizeof(std::uint64_t);
+  const unsigned cores = std::max(1U, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= cores; threads *= 2)
+  {
+    report("sum", threads, bytes,
+      best_time([&] { return std::compute::sum(column, threads).value_or(0); }));
+    report("mean", threads, bytes,
+      best_time([&] { return std::compute::mean(column, threads).value_or(0); }));
+    report("min", threads, bytes,
+      best_time([&] { return std::compute::min(column, threads).value_or(0); }));
+  }
+  return 0;
+}
@@ -0,0 +1,160 @@
+#pragma once
+// A small self-contained microbenchmark harness: warm-up, repeated
+// samples of a batch of operations, median and p99 per operation,
+// optionally hardware counters per operation, and JSON output that diffs
+// cleanly between runs.
+#include "perf.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+  //! Makes the compiler assume value is read, so computing it can't be elided
+  template<class T>
+  inline void do_not_optimize(T const & value)
+  {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  //! Makes the compiler assume all memory is read and written
+  inline void clobber_memory()
+  {
+    asm volatile("" : : : "memory");
+  }
+
+  struct options
+  {
+    int warmup = 20;
+    int samples = 200;
+    //! Counted during time_ns when set, see perf.hpp
+    perf_counters * counters = nullptr;
+  };
+
+  struct result
+  {
+    std::string name;
+    std::string impl;
+    std::string payload;
+    std::string op;
+    double median_ns;
+    double p99_ns;
+    int samples;
+    //! Median per operation of each counter that could be read
+    counter_values counters{};
+    std::array<bool, counter_count> counted{};
+  };
+
+  namespace detail {
+    struct counting
+    {
+      perf_counters * counters = nullptr;
+      counter_values totals{};
+    };
+
+    inline counting & current()
+    {
+      static counting c;
+      return c;
+    }
+
+    inline double median(std::vector<double> & v)
+    {
+      std::sort(v.begin(), v.end());
+      return v[v.size() / 2];
+    }
+  }
+
+  /*! Times samples of batch(), which performs ops operations and returns
+      the nanoseconds it measured itself (so it can leave set up and
+      tear down out of the timing).  Reports nanoseconds, and with
+      opt.counters the counters time_ns saw, per operation.
+  */
+  template<class Batch>
+  result measure(options const & opt, std::size_t ops, Batch && batch)
+  {
+    for (int i = 0; i != opt.warmup; ++i)
+    {
+      batch();
+    }
+    detail::counting & c = detail::current();
+    c.counters = opt.counters;
+    std::vector<double> per_op;
+    std::array<std::vector<double>, counter_count> counters_per_op;
+    per_op.reserve(static_cast<std::size_t>(opt.samples));
+    for (int i = 0; i != opt.samples; ++i)
+    {
+      c.totals.fill(0);
+      per_op.push_back(batch() / static_cast<double>(ops));
+      for (std::size_t k = 0; k != counter_count; ++k)
+      {
+        counters_per_op[k].push_back(c.totals[k] / static_cast<double>(ops));
+      }
+    }
+    c.counters = nullptr;
+
+    std::size_t p99 = static_cast<std::size_t>(std::ceil(0.99 * per_op.size())) - 1;
+    result r;
+    r.median_ns = detail::median(per_op);
+    r.p99_ns = per_op[std::min(p99, per_op.size() - 1)];
+    r.samples = opt.samples;
+    for (std::size_t k = 0; k != counter_count; ++k)
+    {
+      r.counted[k] = opt.counters && opt.counters->has(k);
+      r.counters[k] = r.counted[k] ? detail::median(counters_per_op[k]) : 0;
+    }
+    return r;
+  }
+
+  /*! Runs f and returns how long it took in nanoseconds.  The clock is
+      read outside the counted window, so the counters don't see the
+      vDSO call; the time does include one ioctl each to start and stop
+      the counter group.
+  */
+  template<class F>
+  double time_ns(F && f)
+  {
+    detail::counting & c = detail::current();
+    clobber_memory();
+    auto start = std::chrono::steady_clock::now();
+    if (c.counters)
+    {
+      c.counters->start();
+    }
+    f();
+    if (c.counters)
+    {
+      c.counters->stop(c.totals);
+    }
+    clobber_memory();
+    std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+  }
+
+  inline void write_json(std::FILE * out, std::vector<result> const & results)
+  {
+    std::fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (std::size_t i = 0; i != results.size(); ++i)
+    {
+      result const & r = results[i];
+      std::fprintf(out,
+        "    {\"name\": \"%s\", \"impl\": \"%s\", \"payload\": \"%s\", \"op\": \"%s\", "
+        "\"median_ns\": %.3f, \"p99_ns\": %.3f, \"samples\": %d",
+        r.name.c_str(), r.impl.c_str(), r.payload.c_str(), r.op.c_str(),
+        r.median_ns, r.p99_ns, r.samples);
+      bool any = false;
+      for (std::size_t k = 0; k != counter_count; ++k)
+      {
+        if (r.counted[k])
+        {
+          std::fprintf(out, "%s\"%s\": %.3f", any ? ", " : ", \"counters\": {", counter_name(k), r.counters[k]);
+          any = true;
+        }
+      }
+      std::fprintf(out, "%s}%s\n", any ? "}" : "", i + 1 == results.size() ? "" : ",");
+    }
+    std::fprintf(out, "  ]\n}\n");
+  }
+}
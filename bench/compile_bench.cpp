@@ -0,0 +1,63 @@
+// COMPILE_BENCH_TYPES distinct optional<T>, each through its constrained
+// constructors and assignments, so compiling this file times the
+// constraint checks in enable_if.hpp.  compile_bench.py compiles it and
+// reports the time and memory that took; it is never linked or run.
+#include <optional.hpp>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+#ifndef COMPILE_BENCH_TYPES
+#define COMPILE_BENCH_TYPES 1000
+#endif
+
+namespace {
+  struct Trivial_Base
+  {
+  };
+
+  struct Destructor_Base
+  {
+    ~Destructor_Base() {}
+  };
+
+  //! Odd N are not trivially destructible, to cover both optional<T, B>
+  template<int N>
+  struct Synthetic : std::conditional_t<N % 2 == 0, Trivial_Base, Destructor_Base>
+  {
+    Synthetic() = default;
+    Synthetic(int x) : value(x) {}
+    int value = N;
+  };
+
+  template<int N>
+  int use()
+  {
+    using T = Synthetic<N>;
+    std::optional<T> a;
+    std::optional<T> b{std::in_place, N};
+    std::optional<T> c{b};
+    std::optional<T> d{std::move(c)};
+    a = b;
+    a = std::move(d);
+    a = T(N);
+    a = N;
+    a = std::nullopt;
+    a.emplace(N);
+    a.swap(b);
+    return a.value_or(T()).value + b.transform([](const T & x) { return x.value; }).value_or(0);
+  }
+
+  template<int... N>
+  int use_all(std::integer_sequence<int, N...>)
+  {
+    int r = 0;
+    (void)std::initializer_list<int>{(r += use<N>())...};
+    return r;
+  }
+}
+
+int main()
+{
+  return use_all(std::make_integer_sequence<int, COMPILE_BENCH_TYPES>()) == 0;
+}
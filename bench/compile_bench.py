@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+# Compiles compile_bench.cpp some number of times and prints, as JSON, the
+# median wall time and the peak resident memory of the compiler.  Only the
+# front end runs (-fsyntax-only), which is where the constraints cost.
+#   compile_bench.py [--runs N] [--types N] -- compiler [flags...]
+from __future__ import print_function
+import json
+import os
+import resource
+import subprocess
+import sys
+import time
+
+
+def main(argv):
+  runs = 1
+  types = 1000
+  while argv and argv[0] != '--':
+    option = argv.pop(0)
+    if option == '--runs':
+      runs = int(argv.pop(0))
+    elif option == '--types':
+      types = int(argv.pop(0))
+    else:
+      sys.exit('unknown option %s' % option)
+  compiler = argv[1:]
+  if not compiler:
+    sys.exit('usage: compile_bench.py [--runs N] [--types N] -- compiler [flags...]')
+
+  source = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'compile_bench.cpp')
+  seconds = []
+  for _ in range(runs):
+    start = time.time()
+    subprocess.check_call(compiler + ['-DCOMPILE_BENCH_TYPES=%d' % types, '-fsyntax-only', source])
+    seconds.append(time.time() - start)
+
+  # children are only the compiler runs; ru_maxrss is in KB on Linux
+  peak_kb = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+  seconds.sort()
+  print(json.dumps({
+    'types': types,
+    'runs': runs,
+    'median_seconds': round(seconds[len(seconds) // 2], 3),
+    'peak_rss_mb': round(peak_kb / 1024.0, 1),
+  }, sort_keys=True))
+
+
+if __name__ == '__main__':
+  main(sys.argv[1:])
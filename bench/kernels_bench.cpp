@@ -0,0 +1,179 @@
+// Scan kernels against the naive has_value() loops they replace.  The
+// naive loop runs over both a vector<optional<T>> and the same
+// optional_vector the kernel scans: "layout x" is what the bitmap column
+// saves on its own, "kernel x" what the kernel adds on top of it.
+//   kernels_bench [rows] [density]
+#include <optional_kernels.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+  volatile std::size_t sink;
+
+  //! Best of a few runs, in nanoseconds per row
+  template<class F>
+  double time_per_row(std::size_t rows, F && f)
+  {
+    double best = 1e300;
+    for (int run = 0; run != 7; ++run)
+    {
+      auto start = std::chrono::steady_clock::now();
+      sink = f();
+      std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+      best = std::min(best, took.count() / rows);
+    }
+    return best;
+  }
+
+  void report(const char * name, double aos, double soa, double kernel)
+  {
+    std::printf("%-14s %8.3f ns/row %8.3f ns/row %8.3f ns/row %7.2fx %7.2fx\n",
+      name, aos, soa, kernel, aos / soa, soa / kernel);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+  double density = argc > 2 ? std::atof(argv[2]) : 0.5;
+
+#if defined(__AVX512F__)
+  const char * isa = "avx512";
+#elif defined(__AVX2__)
+  const char * isa = "avx2";
+#else
+  const char * isa = "scalar";
+#endif
+  std::printf("%zu rows, density %.2f, %s kernels\n", rows, density, isa);
+  std::printf("%-14s %15s %15s %15s %8s %8s\n", "", "naive aos", "naive soa", "kernel", "layout x", "kernel x");
+
+  std::mt19937_64 rng(1);
+  std::bernoulli_distribution engaged(density);
+  std::vector<std::optional<std::int64_t>> aos(rows);
+  std::optional_vector<std::int64_t> soa;
+  soa.reserve(rows);
+  for (std::size_t i = 0; i != rows; ++i)
+  {
+    if (engaged(rng))
+    {
+      aos[i] = static_cast<std::int64_t>(i);
+      soa.push_back(static_cast<std::int64_t>(i));
+    }
+    else
+    {
+      soa.push_back(std::nullopt);
+    }
+  }
+
+  report("count_engaged",
+    time_per_row(rows, [&] {
+      std::size_t n = 0;
+      for (auto const & o : aos)
+      {
+        if (o.has_value())
+        {
+          ++n;
+        }
+      }
+      return n;
+    }),
+    time_per_row(rows, [&] {
+      std::size_t n = 0;
+      for (std::size_t i = 0; i != rows; ++i)
+      {
+        if (soa.has_value(i))
+        {
+          ++n;
+        }
+      }
+      return n;
+    }),
+    time_per_row(rows, [&] { return std::count_engaged(soa); }));
+
+  std::vector<std::int64_t> dense(rows);
+  report("compact",
+    time_per_row(rows, [&] {
+      std::int64_t * out = dense.data();
+      for (auto const & o : aos)
+      {
+        if (o.has_value())
+        {
+          *out++ = *o;
+        }
+      }
+      return static_cast<std::size_t>(out - dense.data());
+    }),
+    time_per_row(rows, [&] {
+      std::int64_t * out = dense.data();
+      const std::int64_t * values = soa.data();
+      for (std::size_t i = 0; i != rows; ++i)
+      {
+        if (soa.has_value(i))
+        {
+          *out++ = values[i];
+        }
+      }
+      return static_cast<std::size_t>(out - dense.data());
+    }),
+    time_per_row(rows, [&] {
+      return static_cast<std::size_t>(std::compact(soa, dense.data()) - dense.data());
+    }));
+
+  std::vector<std::optional<std::int64_t>> aos_out(rows);
+  std::vector<std::int64_t> soa_out(rows);
+  report("expand",
+    time_per_row(rows, [&] {
+      const std::int64_t * in = dense.data();
+      for (std::size_t i = 0; i != rows; ++i)
+      {
+        if (aos[i].has_value())
+        {
+          aos_out[i] = *in++;
+        }
+      }
+      return static_cast<std::size_t>(in - dense.data());
+    }),
+    time_per_row(rows, [&] {
+      const std::int64_t * in = dense.data();
+      for (std::size_t i = 0; i != rows; ++i)
+      {
+        if (soa.has_value(i))
+        {
+          soa_out[i] = *in++;
+        }
+      }
+      return static_cast<std::size_t>(in - dense.data());
+    }),
+    time_per_row(rows, [&] {
+      return static_cast<std::size_t>(
+        std::expand(dense.data(), soa.bitmap(), rows, soa_out.data()) - dense.data());
+    }));
+
+  // everything empty but the last row: the whole column is scanned
+  std::vector<std::optional<std::int64_t>> aos_last(rows);
+  std::optional_vector<std::int64_t> soa_last(rows);
+  aos_last.back() = 1;
+  soa_last.emplace(rows - 1, 1);
+  report("first_engaged",
+    time_per_row(rows, [&] {
+      std::size_t i = 0;
+      while (i != rows && !aos_last[i].has_value())
+      {
+        ++i;
+      }
+      return i;
+    }),
+    time_per_row(rows, [&] {
+      std::size_t i = 0;
+      while (i != rows && !soa_last.has_value(i))
+      {
+        ++i;
+      }
+      return i;
+    }),
+    time_per_row(rows, [&] { return std::first_engaged(soa_last); }));
+  return 0;
+}
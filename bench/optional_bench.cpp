@@ -0,0 +1,262 @@
+// Construct, destroy, value(), swap and reset of this optional against
+// libstdc++'s std::experimental::optional (its C++17 <optional> would
+// clash with this library's std::optional) and a hand-rolled bool +
+// union baseline, for a trivial, a non-trivial and a large payload.
+// Prints JSON; --counters adds hardware counters per element where
+// perf_event_open is permitted.
+//   optional_bench [--counters] [samples]
+#include "bench.hpp"
+#include <optional.hpp>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <experimental/optional>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+  //! The baseline: an engaged flag next to a union, nothing else
+  template<class T>
+  class flag_optional
+  {
+    public:
+    flag_optional() noexcept : engaged_(false) {}
+
+    explicit flag_optional(T const & value) : engaged_(true)
+    {
+      ::new (static_cast<void*>(&value_)) T(value);
+    }
+
+    flag_optional(flag_optional const &) = delete;
+    flag_optional & operator=(flag_optional const &) = delete;
+
+    ~flag_optional()
+    {
+      reset();
+    }
+
+    bool has_value() const noexcept
+    {
+      return engaged_;
+    }
+
+    T & value()
+    {
+      if (!engaged_)
+      {
+        throw std::bad_optional_access();
+      }
+      return value_;
+    }
+
+    void reset() noexcept
+    {
+      if (engaged_)
+      {
+        value_.~T();
+        engaged_ = false;
+      }
+    }
+
+    template<class... Args>
+    void emplace(Args&&... args)
+    {
+      reset();
+      ::new (static_cast<void*>(&value_)) T(std::forward<Args>(args)...);
+      engaged_ = true;
+    }
+
+    void swap(flag_optional & other)
+    {
+      if (engaged_ && other.engaged_)
+      {
+        using std::swap;
+        swap(value_, other.value_);
+      }
+      else if (engaged_)
+      {
+        other.emplace(std::move(value_));
+        reset();
+      }
+      else if (other.engaged_)
+      {
+        emplace(std::move(other.value_));
+        other.reset();
+      }
+    }
+
+    private:
+    bool engaged_;
+    union
+    {
+      T value_;
+    };
+  };
+
+  struct this_optional
+  {
+    static constexpr const char * name = "optional";
+    template<class T> using type = std::optional<T>;
+    template<class O> static void reset(O & o) { o.reset(); }
+  };
+
+  struct experimental_optional
+  {
+    static constexpr const char * name = "experimental";
+    template<class T> using type = std::experimental::optional<T>;
+    template<class O> static void reset(O & o) { o = std::experimental::nullopt; }
+  };
+
+  struct flag_union
+  {
+    static constexpr const char * name = "flag_union";
+    template<class T> using type = flag_optional<T>;
+    template<class O> static void reset(O & o) { o.reset(); }
+  };
+
+  struct Large
+  {
+    std::array<std::uint64_t, 32> words;
+  };
+
+  //! Payload values, and their names in the JSON
+  int make(int) { return 42; }
+  std::string make(std::string) { return "fits in SSO"; }
+  Large make(Large) { Large l{}; l.words[3] = 42; return l; }
+
+  const char * payload_name(int) { return "trivial"; }
+  const char * payload_name(std::string) { return "non_trivial"; }
+  const char * payload_name(Large) { return "large"; }
+
+  constexpr std::size_t slots = 256;
+
+  template<class Impl, class T>
+  void run(bench::options const & opt, std::vector<bench::result> & results)
+  {
+    using O = typename Impl::template type<T>;
+    const T payload = make(T());
+    typename std::aligned_storage<sizeof(O), alignof(O)>::type raw[slots];
+    O * const objects = reinterpret_cast<O *>(raw);
+
+    auto add = [&](const char * op, bench::result r) {
+      r.impl = Impl::name;
+      r.payload = payload_name(T());
+      r.op = op;
+      r.name = r.payload + "/" + r.op + "/" + r.impl;
+      results.push_back(r);
+    };
+
+    add("construct", bench::measure(opt, slots, [&] {
+      double ns = bench::time_ns([&] {
+        for (std::size_t i = 0; i != slots; ++i)
+        {
+          ::new (static_cast<void*>(objects + i)) O(payload);
+        }
+      });
+      for (std::size_t i = 0; i != slots; ++i)
+      {
+        objects[i].~O();
+      }
+      return ns;
+    }));
+
+    add("destroy", bench::measure(opt, slots, [&] {
+      for (std::size_t i = 0; i != slots; ++i)
+      {
+        ::new (static_cast<void*>(objects + i)) O(payload);
+      }
+      return bench::time_ns([&] {
+        for (std::size_t i = 0; i != slots; ++i)
+        {
+          objects[i].~O();
+        }
+      });
+    }));
+
+    std::vector<O> a(slots);
+    std::vector<O> b(slots);
+    for (std::size_t i = 0; i != slots; ++i)
+    {
+      a[i].emplace(payload);
+      if (i % 2)
+      {
+        b[i].emplace(payload);
+      }
+    }
+
+    add("value", bench::measure(opt, slots, [&] {
+      return bench::time_ns([&] {
+        for (std::size_t i = 0; i != slots; ++i)
+        {
+          bench::do_not_optimize(a[i].value());
+        }
+      });
+    }));
+
+    // half the pairs are both engaged, half move the value across
+    add("swap", bench::measure(opt, slots, [&] {
+      return bench::time_ns([&] {
+        for (std::size_t i = 0; i != slots; ++i)
+        {
+          a[i].swap(b[i]);
+        }
+      });
+    }));
+
+    add("reset", bench::measure(opt, slots, [&] {
+      for (std::size_t i = 0; i != slots; ++i)
+      {
+        a[i].emplace(payload);
+      }
+      return bench::time_ns([&] {
+        for (std::size_t i = 0; i != slots; ++i)
+        {
+          Impl::reset(a[i]);
+        }
+      });
+    }));
+  }
+
+  template<class T>
+  void run_all(bench::options const & opt, std::vector<bench::result> & results)
+  {
+    run<this_optional, T>(opt, results);
+    run<experimental_optional, T>(opt, results);
+    run<flag_union, T>(opt, results);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  bench::options opt;
+  bench::perf_counters counters;
+  for (int i = 1; i != argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--counters") == 0)
+    {
+      if (counters.available())
+      {
+        opt.counters = &counters;
+      }
+      else
+      {
+        std::fprintf(stderr, "optional_bench: hardware counters unavailable, reporting time only\n");
+      }
+    }
+    else
+    {
+      opt.samples = std::max(1, std::atoi(argv[i]));
+    }
+  }
+  std::vector<bench::result> results;
+  run_all<int>(opt, results);
+  run_all<std::string>(opt, results);
+  run_all<Large>(opt, results);
+  bench::write_json(stdout, results);
+  return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+// Hardware counters through Linux's perf_event_open, user space only.
+// The counters form one group, started, stopped and read together so
+// they all cover the same instructions.  One the kernel refuses (no PMU
+// in a VM, perf_event_paranoid, seccomp) only drops that column; elsewhere
+// none are available and only time is reported.
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+  constexpr std::size_t counter_count = 5;
+
+  using counter_values = std::array<double, counter_count>;
+
+  inline const char * counter_name(std::size_t i)
+  {
+    static const char * const names[counter_count] = {
+      "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+    };
+    return names[i];
+  }
+
+  class perf_counters
+  {
+    public:
+    perf_counters()
+    {
+      fds_.fill(-1);
+      slots_.fill(counter_count);
+#if defined(__linux__)
+      const std::uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      const std::uint32_t types[counter_count] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+      };
+      const std::uint64_t configs[counter_count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        l1d_read_miss, PERF_COUNT_HW_CACHE_MISSES
+      };
+      for (std::size_t i = 0; i != counter_count; ++i)
+      {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        // the first counter that opens leads the group and starts it
+        attr.disabled = leader_ < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // to scale for multiplexing when another group takes the PMU
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds_[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader_, PERF_FLAG_FD_CLOEXEC));
+        if (fds_[i] >= 0)
+        {
+          slots_[i] = members_++;
+          if (leader_ < 0)
+          {
+            leader_ = fds_[i];
+          }
+        }
+      }
+#endif
+    }
+
+    perf_counters(perf_counters const &) = delete;
+    perf_counters & operator=(perf_counters const &) = delete;
+
+    ~perf_counters()
+    {
+#if defined(__linux__)
+      for (int fd : fds_)
+      {
+        if (fd >= 0)
+        {
+          close(fd);
+        }
+      }
+#endif
+    }
+
+    bool has(std::size_t i) const
+    {
+      return fds_[i] >= 0;
+    }
+
+    //! True if at least one counter could be opened
+    bool available() const
+    {
+      for (std::size_t i = 0; i != counter_count; ++i)
+      {
+        if (has(i))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+      if (leader_ >= 0)
+      {
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+#endif
+    }
+
+    //! Stops counting and adds what was counted since start() to totals
+    void stop(counter_values & totals)
+    {
+#if defined(__linux__)
+      if (leader_ < 0)
+      {
+        return;
+      }
+      ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      // members, time enabled, time running, then a value per member
+      std::uint64_t v[3 + counter_count];
+      const ssize_t size = static_cast<ssize_t>((3 + members_) * sizeof(std::uint64_t));
+      if (read(leader_, v, sizeof(v)) != size || v[0] != members_ || !v[2])
+      {
+        return;
+      }
+      const double scale = static_cast<double>(v[1]) / static_cast<double>(v[2]);
+      for (std::size_t i = 0; i != counter_count; ++i)
+      {
+        if (has(i))
+        {
+          totals[i] += static_cast<double>(v[3 + slots_[i]]) * scale;
+        }
+      }
+#else
+      (void)totals;
+#endif
+    }
+
+    private:
+    std::array<int, counter_count> fds_;
+    std::array<std::size_t, counter_count> slots_; //!< place in the group's read
+    std::size_t members_ = 0;
+    int leader_ = -1;
+  };
+}
@@ -1,27 +1,23 @@
 namespace detail {
   enum class enabler {};
+
+  template<bool...>
+  struct bool_pack;
 }
 // This works around a clang issue
 // http://flamingdangerzone.com/cxx11/2012/06/01/almost-static-if.html
 constexpr detail::enabler Enable = {};
 
-template<class First, class ... T>
+/*! True if every T::value is.  Flat rather than recursive: the two packs
+    only match if all values are true, so each distinct all<...> costs one
+    is_same instead of a chain of std::conditional, one per condition.
+*/
+template<class ... T>
 struct all
-  : std::conditional<
-      First::value,
-      typename all<T...>::type,
-      std::false_type
-    >::type
-{
-};
-
-template<class First>
-struct all<First>
-  : std::conditional<
-      First::value,
-      std::true_type,
-      std::false_type
-    >::type
+  : std::is_same<
+      detail::bool_pack<true, T::value...>,
+      detail::bool_pack<T::value..., true>
+    >
 {
 };
 
@@ -32,10 +28,10 @@ template <typename Ret, typename ... Condition>
 using Enable_When = typename std::enable_if<all<Condition...>::value, Ret>::type;
 
 template<class T>
-using Not = typename std::conditional<!T::value, std::true_type, std::false_type>::type;
+using Not = std::integral_constant<bool, !T::value>;
 
 template <typename ... Condition>
 using When_Not = typename std::enable_if<all<Not<Condition>...>::value, detail::enabler>::type;
 
 template<class T>
-using Is = typename std::conditional<T::value, std::true_type, std::false_type>::type;
+using Is = std::integral_constant<bool, T::value>;
@@ -2,10 +2,52 @@
 #include <type_traits>
 #include <utility>
 #include <algorithm> 
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
 #include "enable_if.hpp"
 
+// Builds without exceptions call the bad_optional_access handler instead
+// of throwing.  Detected from the compiler, define to 0/1 to override.
+#ifndef OPTIONAL_NO_EXCEPTIONS
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define OPTIONAL_NO_EXCEPTIONS 0
+#else
+#define OPTIONAL_NO_EXCEPTIONS 1
+#endif
+#endif
+
+// optional<bool> in one byte reads a char union member while the bool is
+// the active one, which only GCC and clang define, and which is never a
+// constant expression: has_value() of optional<bool> is not constexpr
+// then.  Define to 0 for the flag layout and a constexpr has_value().
+#ifndef OPTIONAL_ONE_BYTE_BOOL
+#if defined(__GNUC__)
+#define OPTIONAL_ONE_BYTE_BOOL 1
+#else
+#define OPTIONAL_ONE_BYTE_BOOL 0
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define OPTIONAL_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define OPTIONAL_COLD __attribute__((noinline, cold))
+#else
+#define OPTIONAL_UNLIKELY(x) (x)
+#define OPTIONAL_COLD
+#endif
+
 namespace std {
-  struct nullopt_t {};
+  //! Not default constructible, so o = {} picks the copy/move assignment
+  struct nullopt_t {
+    struct tag {};
+    constexpr explicit nullopt_t(tag) {}
+  };
+  constexpr nullopt_t nullopt{nullopt_t::tag()};
   struct in_place_t {
     explicit in_place_t() = default;
   };
@@ -18,7 +60,125 @@ namespace std {
     }
   };
 
-  //inline constexpr std::in_place_t in_place{};
+#if OPTIONAL_NO_EXCEPTIONS
+  /*! Called on access to an empty optional when exceptions are disabled.
+      It must not return; if it does the program is aborted anyway.
+      Defaults to std::abort, install e.g. a log-and-abort or a trap.
+  */
+  using bad_optional_access_handler = void (*)();
+
+  inline bad_optional_access_handler & bad_optional_access_handler_() noexcept
+  {
+    static bad_optional_access_handler handler = &std::abort;
+    return handler;
+  }
+
+  //! Installs a new handler and returns the previous one
+  inline bad_optional_access_handler set_bad_optional_access_handler(
+    bad_optional_access_handler handler) noexcept
+  {
+    bad_optional_access_handler previous = bad_optional_access_handler_();
+    bad_optional_access_handler_() = handler ? handler : &std::abort;
+    return previous;
+  }
+
+  inline bad_optional_access_handler get_bad_optional_access_handler() noexcept
+  {
+    return bad_optional_access_handler_();
+  }
+#endif
+
+  /*! Opt-in hook letting a type give up one of its values to mean "empty".
+      Specialise it with
+        static constexpr T empty_value() noexcept;
+        static constexpr bool is_empty(T const &) noexcept;
+      (is_empty only needs to be constexpr for constexpr has_value())
+      and optional<T> drops its engaged flag and is the same size as T.
+      Destroying empty_value() must be a no-op, which any trivially
+      destructible T satisfies.  Storing a value for which
+      is_empty() is true leaves the optional disengaged.
+  */
+  template<class T>
+  struct optional_traits {};
+
+  //! Ready made traits for integral, enum and pointer sentinels
+  template<class T, T Empty>
+  struct optional_sentinel
+  {
+    static constexpr T empty_value() noexcept
+    {
+      return Empty;
+    }
+
+    static constexpr bool is_empty(T const & t) noexcept
+    {
+      return t == Empty;
+    }
+  };
+
+#ifndef OPTIONAL_NAN_SENTINEL
+// x87 loads quieten signalling NaNs, so only use the NaN niche where
+// doubles travel through SSE registers or memory.  is_empty() compares
+// bits, which needs __builtin_bit_cast (GCC 11, clang 9) to stay constexpr.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bit_cast) && defined(__GNUC__) && (!defined(__i386__) || defined(__SSE2_MATH__))
+#define OPTIONAL_NAN_SENTINEL 1
+#endif
+#endif
+#ifndef OPTIONAL_NAN_SENTINEL
+#define OPTIONAL_NAN_SENTINEL 0
+#endif
+#endif
+
+#if OPTIONAL_NAN_SENTINEL
+  /*! optional<double> and optional<float> reserve one signalling NaN
+      payload for "empty".  Every other NaN, including the ones
+      numeric_limits hands out and the ones arithmetic produces, is an
+      ordinary engaged value.  The check compares bits so it never raises
+      a floating point exception.
+  */
+  template<>
+  struct optional_traits<double>
+  {
+    static constexpr std::uint64_t empty_bits = 0x7ff000000badf00dULL;
+
+    static constexpr double empty_value() noexcept
+    {
+      return __builtin_nans("0xbadf00d");
+    }
+
+    static constexpr bool is_empty(double const & d) noexcept
+    {
+      return __builtin_bit_cast(std::uint64_t, d) == empty_bits;
+    }
+  };
+
+  template<>
+  struct optional_traits<float>
+  {
+    static constexpr std::uint32_t empty_bits = 0x7f8badf0UL;
+
+    static constexpr float empty_value() noexcept
+    {
+      return __builtin_nansf("0xbadf0");
+    }
+
+    static constexpr bool is_empty(float const & f) noexcept
+    {
+      return __builtin_bit_cast(std::uint32_t, f) == empty_bits;
+    }
+  };
+#endif
+
+  constexpr in_place_t in_place{};
+
+  /*! Tag for constructing the value from the prvalue a callable returns,
+      which is materialised straight in the optional's storage.
+  */
+  struct from_invoke_t {
+    explicit from_invoke_t() = default;
+  };
+  constexpr from_invoke_t from_invoke{};
   //template <class T> struct in_place_type_t {
   //  explicit in_place_type_t() = default;
   //};
@@ -46,6 +206,10 @@ namespace detail {
     
     constexpr storage_(T const & t) : t_(t) {}
     constexpr storage_(T && t) : t_(std::move(t)) {}
+    template<class... Args>
+    constexpr explicit storage_(std::in_place_t, Args&&... args) : t_(std::forward<Args>(args)...) {}
+    template<class F>
+    constexpr storage_(std::in_place_t, std::from_invoke_t, F && f) : t_(std::forward<F>(f)()) {}
 
     constexpr T & value() & {
       return t_;
@@ -53,6 +217,12 @@ namespace detail {
     constexpr T const & value() const & {
       return t_;
     }
+    constexpr T && value() && {
+      return std::move(t_);
+    }
+    constexpr T const && value() const && {
+      return std::move(t_);
+    }
     
     T t_;
     char x;
@@ -64,6 +234,10 @@ namespace detail {
     constexpr storage_() : x() {}
     constexpr storage_(T const & t) : t_(t) {}
     constexpr storage_(T && t) : t_(std::move(t)) {}
+    template<class... Args>
+    constexpr explicit storage_(std::in_place_t, Args&&... args) : t_(std::forward<Args>(args)...) {}
+    template<class F>
+    constexpr storage_(std::in_place_t, std::from_invoke_t, F && f) : t_(std::forward<F>(f)()) {}
 
     constexpr T & value() & {
       return t_;
@@ -72,6 +246,14 @@ namespace detail {
     constexpr T const & value() const & {
       return t_;
     }
+
+    constexpr T && value() && {
+      return std::move(t_);
+    }
+
+    constexpr T const && value() const && {
+      return std::move(t_);
+    }
     
     ~storage_() { }
     T t_;
@@ -80,6 +262,210 @@ namespace detail {
 
   template<class T>
   using storage = storage_<T, std::is_trivially_destructible<T>::value>;
+
+  /*! The engaged flag.  A third state lets optional<optional<T>> keep its
+      own emptiness in the inner optional's flag instead of adding one.
+  */
+  enum class state : unsigned char
+  {
+    empty,
+    engaged,
+    nested_empty
+  };
+
+  struct nested_empty_t
+  {
+    explicit nested_empty_t() = default;
+  };
+
+  /*! Value storage for trivial class types whose tail padding the ABI
+      lets a derived class reuse: the flag is a member of a class derived
+      from T, so it lands in T's padding instead of after it.  T is
+      always alive (it is trivial), disengaged just means unspecified.
+  */
+  template<class T>
+  struct tail_storage_ : T
+  {
+    constexpr explicit tail_storage_(state s = state::empty) : T(), initalized_(s) {}
+    template<class... Args>
+    constexpr explicit tail_storage_(std::in_place_t, Args&&... args)
+      : T(std::forward<Args>(args)...)
+      , initalized_(state::engaged)
+    {
+    }
+    template<class F>
+    constexpr tail_storage_(std::in_place_t, std::from_invoke_t, F && f)
+      : T(std::forward<F>(f)())
+      , initalized_(state::engaged)
+    {
+    }
+
+    constexpr T & value() & {
+      return *this;
+    }
+    constexpr T const & value() const & {
+      return *this;
+    }
+    constexpr T && value() && {
+      return std::move(*this);
+    }
+    constexpr T const && value() const && {
+      return std::move(*this);
+    }
+
+    state initalized_;
+  };
+
+  /*! Value storage for empty T: the engaged member derives from T, so T
+      takes no bytes and the state byte is the whole object.  While
+      disengaged only the state is alive.  Both members are standard
+      layout and start with the state, so it can be read through either.
+  */
+  template<class T>
+  struct empty_engaged_ : T
+  {
+    template<class... Args>
+    constexpr explicit empty_engaged_(std::in_place_t, Args&&... args)
+      : T(std::forward<Args>(args)...)
+      , initalized_(state::engaged)
+    {
+    }
+    template<class F>
+    constexpr empty_engaged_(std::in_place_t, std::from_invoke_t, F && f)
+      : T(std::forward<F>(f)())
+      , initalized_(state::engaged)
+    {
+    }
+
+    state initalized_;
+  };
+
+  struct empty_disengaged_
+  {
+    state initalized_;
+  };
+
+  template<class T, bool>
+  union empty_storage_;
+
+  template<class T>
+  union empty_storage_<T, true>
+  {
+    constexpr explicit empty_storage_(state s = state::empty) : s_{s} {}
+    template<class... Args>
+    constexpr explicit empty_storage_(std::in_place_t, Args&&... args)
+      : t_(std::in_place_t(), std::forward<Args>(args)...) {}
+
+    constexpr T & value() & {
+      return t_;
+    }
+    constexpr T const & value() const & {
+      return t_;
+    }
+    constexpr T && value() && {
+      return std::move(t_);
+    }
+    constexpr T const && value() const && {
+      return std::move(t_);
+    }
+
+    empty_disengaged_ s_;
+    empty_engaged_<T> t_;
+  };
+
+  template<class T>
+  union empty_storage_<T, false>
+  {
+    constexpr explicit empty_storage_(state s = state::empty) : s_{s} {}
+    template<class... Args>
+    constexpr explicit empty_storage_(std::in_place_t, Args&&... args)
+      : t_(std::in_place_t(), std::forward<Args>(args)...) {}
+
+    constexpr T & value() & {
+      return t_;
+    }
+
+    constexpr T const & value() const & {
+      return t_;
+    }
+
+    constexpr T && value() && {
+      return std::move(t_);
+    }
+
+    constexpr T const && value() const && {
+      return std::move(t_);
+    }
+
+    ~empty_storage_() { }
+    empty_disengaged_ s_;
+    empty_engaged_<T> t_;
+  };
+
+  template<class T>
+  using empty_storage = empty_storage_<T, std::is_trivially_destructible<T>::value>;
+
+  template<class T>
+  struct tail_probe_ : T
+  {
+    unsigned char flag_;
+  };
+
+  template<class T, bool = 
+    all<
+      std::is_class<T>,
+      Not<std::is_final<T>>,
+      std::is_trivially_default_constructible<T>,
+      std::is_trivially_copyable<T>,
+      std::is_trivially_copy_assignable<T>,
+      std::is_trivially_move_assignable<T>
+    >::value
+  >
+  struct has_reusable_tail : std::false_type {};
+
+  template<class T>
+  struct has_reusable_tail<T, true> 
+    : std::integral_constant<bool, sizeof(tail_probe_<T>) == sizeof(T)> {};
+
+  template<class...>
+  struct voider
+  {
+    using type = void;
+  };
+
+  //! std::optional_traits plus the built-in niche of nested optionals
+  template<class T, class = void>
+  struct sentinel_traits : std::optional_traits<T> {};
+
+  template<class T, class = void>
+  struct has_sentinel : std::false_type {};
+
+  template<class T>
+  struct has_sentinel<T,
+    typename voider<
+      decltype(sentinel_traits<T>::empty_value()),
+      decltype(sentinel_traits<T>::is_empty(std::declval<T const &>()))
+    >::type
+  > : std::true_type {};
+
+  //! How optional_base lays out the engaged state
+  enum class layout
+  {
+    flag,     //!< storage<T> followed by a state byte
+    tail,     //!< state byte placed in T's reusable tail padding
+    empty,    //!< empty T as a base of the state byte, which is all there is
+    sentinel, //!< no state byte, sentinel_traits<T> reserves a value
+    boolean   //!< bool's unused byte values are the empty states
+  };
+
+  template<class T>
+  using layout_of = std::integral_constant<layout,
+    has_sentinel<T>::value ? layout::sentinel :
+    OPTIONAL_ONE_BYTE_BOOL && std::is_same<T, bool>::value ? layout::boolean :
+    has_reusable_tail<T>::value ? layout::tail :
+    all<std::is_empty<T>, Not<std::is_final<T>>, std::is_standard_layout<T>>::value ? layout::empty :
+    layout::flag
+  >;
 }
 
 namespace std {
@@ -93,124 +479,741 @@ namespace detail {
   template<class T>
   Enable_When<void, Not<std::is_trivially_destructible<T>>> destruct(T & t) { t.~T(); } 
 
+  //! Out of line and cold so value()'s throw site stays out of hot loops
+  [[noreturn]] OPTIONAL_COLD inline void throw_bad_optional_access()
+  {
+#if OPTIONAL_NO_EXCEPTIONS
+    std::get_bad_optional_access_handler()();
+    std::abort();
+#else
+    throw std::bad_optional_access();
+#endif
+  }
+
+  //! std::addressof is only constexpr from C++17
   template<class T>
-  class optional<T, true>
+  constexpr T * constexpr_addressof(T & t) noexcept
   {
-    public:
-    using value_type = T;
-    
-    ///Constructor
-    //http://en.cppreference.com/w/cpp/utility/optional/optional
-    constexpr optional() noexcept
-      : initalized_(false)
+#if defined(__GNUC__)
+    return __builtin_addressof(t);
+#else
+    return std::addressof(t);
+#endif
+  }
+
+  template<class T, class... Args>
+  void construct_at(T * p, Args&&... args)
+  {
+    ::new (static_cast<void*>(p)) T(std::forward<Args>(args)...);
+  }
+
+  template<class T, class F>
+  void construct_at(T * p, std::from_invoke_t, F && f)
+  {
+    ::new (static_cast<void*>(p)) T(std::forward<F>(f)());
+  }
+
+  template<class T, class... Args>
+  constexpr T make(Args&&... args)
+  {
+    return T(std::forward<Args>(args)...);
+  }
+
+  template<class T, class F>
+  constexpr T make(std::from_invoke_t, F && f)
+  {
+    return std::forward<F>(f)();
+  }
+
+  //! Result of calling F with Args, std::invoke_result_t for plain callables
+  template<class F, class... Args>
+  using call_result_t = decltype(std::declval<F>()(std::declval<Args>()...));
+
+  /*! Bottom of the special member ladder: owns the engaged flag and the
+      storage and knows how to construct into / destroy out of it.
+      It never destroys the value itself, optional<T, false> does that.
+  */
+  template<class T, layout = layout_of<T>::value>
+  class optional_base
+  {
+    template<class, class> friend struct sentinel_traits;
+
+    protected:
+    constexpr optional_base() noexcept
+      : initalized_(state::empty)
     {
     }
 
-    constexpr optional( std::nullopt_t ) noexcept
-      : optional()
+    constexpr explicit optional_base(nested_empty_t) noexcept
+      : initalized_(state::nested_empty)
     {
     }
 
-    /*! 2) Copy constructor: 
-       If other contains a value, 
-       initializes the contained value as if direct-initializing 
-       (but not direct-list-initializing) 
-       an object of type T with the expression *other. 
-       If other does not contain a value, 
-       constructs an object that does not contain a value. 
-       This constructor is defined as deleted if 
-       std::is_copy_constructible_v<T> is false. 
-       It is a constexpr constructor if std::is_trivially_copy_constructible_v<T> is true.
-    */
-    template<class U = T,
-       When<
-         Is<std::is_copy_constructible<U>>
-       > = Enable
-    >
-    constexpr optional(
-       const optional & other
-    );
-    
+    template<class... Args>
+    constexpr explicit optional_base(std::in_place_t, Args&&... args)
+      : value_(std::in_place_t(), std::forward<Args>(args)...)
+      , initalized_(state::engaged)
+    {
+    }
 
-    /*! 3) Move constructor: 
-        If other contains a value, 
-        initializes the contained value as if direct-initializing 
-        (but not direct-list-initializing) 
-        an object of type T with the expression std::move(*other) 
-        and does not make other empty: 
-        a moved-from optional still contains a value, 
-        but the value itself is moved from. 
-        If other does not contain a value, constructs an object that does 
-        not contain a value. 
-        This constructor does not participate in overload resolution unless 
-        std::is_move_constructible_v<T> is true. 
-        It is a constexpr constructor if std::is_trivially_move_constructible_v<T> is true.
-        3) Throws any exception thrown by the constructor of T. 
-          Has the following noexcept specification:  
-          noexcept(std::is_nothrow_move_constructible<T>::value)
-    */
-    template<class U=T,
-      When<
-        Is<std::is_move_constructible<U>>
-      > = Enable
-    >
-    constexpr optional( optional&& other ) noexcept(std::is_nothrow_move_constructible<T>::value);
+    constexpr bool has_value() const noexcept
+    {
+      return initalized_ == state::engaged;
+    }
 
-    /*! Converting copy constructor: 
-      If other doesn't contain a value, constructs an optional object that 
-      does not contain a value. Otherwise, constructs an optional object that 
-      contains a value, initialized as if direct-initializing 
-      (but not direct-list-initializing) an object 
-      of type T with the expression *other. 
-      
-      This constructor does not participate in overload resolution unless the following conditions are met: 
-      std::is_constructible_v<T, const U&> is true.
-      T is not constructible or convertible from any expression of 
-      type (possibly const) std::optional<U>, 
-      i.e., the following 8 type traits are all false:
-      
-      std::is_constructible_v<T, std::optional<U>&>
-      std::is_constructible_v<T, const std::optional<U>&>
-      std::is_constructible_v<T, std::optional<U>&&>
-      std::is_constructible_v<T, const std::optional<U>&&>
-      std::is_convertible_v<std::optional<U>&, T>
-      std::is_convertible_v<const std::optional<U>&, T>
-      std::is_convertible_v<std::optional<U>&&, T>
-      std::is_convertible_v<const std::optional<U>&&, T>
+    constexpr state get_state() const noexcept
+    {
+      return initalized_;
+    }
 
-      This constructor is explicit if and only if std::is_convertible_v<const U&, T> is false.
-    */
-    template < class U,
-      When<
-        std::is_constructible<T, const U&>,
-        std::is_constructible<T, std::optional<U>&>,
-        std::is_constructible<T, const std::optional<U>&>,
-        std::is_constructible<T, std::optional<U>&&>,
-        std::is_constructible<T, const std::optional<U>&&>,
-        std::is_convertible<std::optional<U>&, T>,
-        std::is_convertible<const std::optional<U>&, T>,
-        std::is_convertible<std::optional<U>&&, T>,
-        std::is_convertible<const std::optional<U>&&, T>,
-        Not<std::is_convertible<const U&, T>>
-      > = Enable
+    template<class... Args>
+    void construct(Args&&... args)
+    {
+      construct_at(std::addressof(value_.t_), std::forward<Args>(args)...);
+      initalized_ = state::engaged;
+    }
+
+    void destroy() noexcept
+    {
+      destruct(value_.value());
+      initalized_ = state::empty;
+    }
+
+    template<class Optional>
+    void assign(Optional && other)
+    {
+      if (has_value() && other.has_value())
+      {
+        value_.value() = std::forward<Optional>(other).value_.value();
+      }
+      else if (other.has_value())
+      {
+        construct(std::forward<Optional>(other).value_.value());
+      }
+      else if (has_value())
+      {
+        destroy();
+      }
+    }
+
+    storage<T> value_;
+    state initalized_;
+  };
+
+  template<class T>
+  class optional_base<T, layout::tail>
+  {
+    template<class, class> friend struct sentinel_traits;
+
+    protected:
+    constexpr optional_base() noexcept
+    {
+    }
+
+    constexpr explicit optional_base(nested_empty_t) noexcept
+      : value_(state::nested_empty)
+    {
+    }
+
+    template<class... Args>
+    constexpr explicit optional_base(std::in_place_t, Args&&... args)
+      : value_(std::in_place_t(), std::forward<Args>(args)...)
+    {
+    }
+
+    constexpr bool has_value() const noexcept
+    {
+      return value_.initalized_ == state::engaged;
+    }
+
+    constexpr state get_state() const noexcept
+    {
+      return value_.initalized_;
+    }
+
+    //! Assigning, not placement new, so T's copy only touches its data size
+    template<class... Args>
+    void construct(Args&&... args)
+    {
+      value_.value() = make<T>(std::forward<Args>(args)...);
+      value_.initalized_ = state::engaged;
+    }
+
+    void destroy() noexcept
+    {
+      value_.initalized_ = state::empty;
+    }
+
+    template<class Optional>
+    void assign(Optional && other)
+    {
+      if (other.has_value())
+      {
+        construct(std::forward<Optional>(other).value_.value());
+      }
+      else
+      {
+        destroy();
+      }
+    }
+
+    tail_storage_<T> value_;
+  };
+
+  /*! Empty T lives in empty_storage<T>, whose state byte is all of
+      optional<T>.  Constructing T creates the engaged member, state and
+      all, in one go; destroying it brings the disengaged member back.
+  */
+  template<class T>
+  class optional_base<T, layout::empty>
+  {
+    template<class, class> friend struct sentinel_traits;
+
+    protected:
+    constexpr optional_base() noexcept
+    {
+    }
+
+    constexpr explicit optional_base(nested_empty_t) noexcept
+      : value_(state::nested_empty)
+    {
+    }
+
+    template<class... Args>
+    constexpr explicit optional_base(std::in_place_t, Args&&... args)
+      : value_(std::in_place_t(), std::forward<Args>(args)...)
+    {
+    }
+
+    constexpr bool has_value() const noexcept
+    {
+      return get_state() == state::engaged;
+    }
+
+    constexpr state get_state() const noexcept
+    {
+      return value_.s_.initalized_;
+    }
+
+    template<class... Args>
+    void construct(Args&&... args)
+    {
+#if OPTIONAL_NO_EXCEPTIONS
+      construct_at(std::addressof(value_.t_), std::in_place_t(), std::forward<Args>(args)...);
+#else
+      try
+      {
+        construct_at(std::addressof(value_.t_), std::in_place_t(), std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+        construct_at(std::addressof(value_.s_), empty_disengaged_{state::empty});
+        throw;
+      }
+#endif
+    }
+
+    void destroy() noexcept
+    {
+      destruct(value_.t_);
+      construct_at(std::addressof(value_.s_), empty_disengaged_{state::empty});
+    }
+
+    template<class Optional>
+    void assign(Optional && other)
+    {
+      if (has_value() && other.has_value())
+      {
+        value_.value() = std::forward<Optional>(other).value_.value();
+      }
+      else if (other.has_value())
+      {
+        construct(std::forward<Optional>(other).value_.value());
+      }
+      else if (has_value())
+      {
+        destroy();
+      }
+    }
+
+    empty_storage<T> value_;
+  };
+
+#if OPTIONAL_ONE_BYTE_BOOL
+  /*! optional<bool> is one byte: an engaged bool is 0 or 1, and while
+      disengaged the union's spare char holds a byte value no bool can
+      have.  Reading that char while the bool is the active member relies
+      on GCC's and clang's union type punning, and is why has_value()
+      can't be evaluated at compile time in this layout.
+  */
+  template<class T>
+  class optional_base<T, layout::boolean>
+  {
+    template<class, class> friend struct sentinel_traits;
+
+    static constexpr char empty_byte = 2;
+    static constexpr char nested_empty_byte = 3;
+
+    protected:
+    constexpr optional_base() noexcept
+    {
+      value_.x = empty_byte;
+    }
+
+    constexpr explicit optional_base(nested_empty_t) noexcept
+    {
+      value_.x = nested_empty_byte;
+    }
+
+    template<class... Args>
+    constexpr explicit optional_base(std::in_place_t, Args&&... args)
+      : value_(std::in_place_t(), std::forward<Args>(args)...)
+    {
+    }
+
+    constexpr bool has_value() const noexcept
+    {
+      return static_cast<unsigned char>(value_.x) < empty_byte;
+    }
+
+    constexpr state get_state() const noexcept
+    {
+      return has_value() ? state::engaged :
+        value_.x == empty_byte ? state::empty : state::nested_empty;
+    }
+
+    template<class... Args>
+    void construct(Args&&... args)
+    {
+      construct_at(std::addressof(value_.t_), std::forward<Args>(args)...);
+    }
+
+    void destroy() noexcept
+    {
+      value_.x = empty_byte;
+    }
+
+    template<class Optional>
+    void assign(Optional && other)
+    {
+      if (other.has_value())
+      {
+        construct(std::forward<Optional>(other).value_.value());
+      }
+      else if (has_value())
+      {
+        destroy();
+      }
+    }
+
+    storage<T> value_;
+  };
+
+#endif
+
+  /*! Sentinel storage: the value is always alive and holds
+      sentinel_traits<T>::empty_value() while disengaged, so there is no
+      flag and has_value() is a compare against the sentinel.
+      Destroying the sentinel must be a no-op, it is simply overwritten.
+  */
+  template<class T>
+  class optional_base<T, layout::sentinel>
+  {
+    using traits = sentinel_traits<T>;
+
+    protected:
+    constexpr optional_base() noexcept
+      : value_(traits::empty_value())
+    {
+    }
+
+    template<class... Args>
+    constexpr explicit optional_base(std::in_place_t, Args&&... args)
+      : value_(std::in_place_t(), std::forward<Args>(args)...)
+    {
+    }
+
+    constexpr bool has_value() const noexcept
+    {
+      return !traits::is_empty(value_.value());
+    }
+
+    template<class... Args>
+    void construct(Args&&... args)
+    {
+#if OPTIONAL_NO_EXCEPTIONS
+      construct_at(std::addressof(value_.t_), std::forward<Args>(args)...);
+#else
+      try
+      {
+        construct_at(std::addressof(value_.t_), std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+        ::new (static_cast<void*>(std::addressof(value_.t_))) T(traits::empty_value());
+        throw;
+      }
+#endif
+    }
+
+    void destroy() noexcept
+    {
+      destruct(value_.value());
+      ::new (static_cast<void*>(std::addressof(value_.t_))) T(traits::empty_value());
+    }
+
+    template<class Optional>
+    void assign(Optional && other)
+    {
+      if (has_value() && other.has_value())
+      {
+        value_.value() = std::forward<Optional>(other).value_.value();
+      }
+      else if (other.has_value())
+      {
+        construct(std::forward<Optional>(other).value_.value());
+      }
+      else if (has_value())
+      {
+        destroy();
+      }
+    }
+
+    storage<T> value_;
+  };
+
+  /*! Each rung of the ladder is left trivial when T's matching special
+      member is, and otherwise supplies a user-provided version on top of
+      optional_base.  The defaulted members of the rungs above then stay
+      trivial exactly when T allows it.  A rung T can't use at all is left
+      defaulted too, optional_enable_* deletes it and triviality of the
+      other members survives.
+  */
+  template<class T, bool = 
+    std::is_trivially_copy_constructible<T>::value ||
+    !std::is_copy_constructible<T>::value
+  >
+  class optional_copy_base : public optional_base<T>
+  {
+    public:
+    using optional_base<T>::optional_base;
+  };
+
+  template<class T>
+  class optional_copy_base<T, false> : public optional_base<T>
+  {
+    public:
+    using optional_base<T>::optional_base;
+
+    optional_copy_base() = default;
+
+    optional_copy_base(const optional_copy_base & other)
+      : optional_base<T>()
+    {
+      if (other.has_value())
+      {
+        this->construct(other.value_.value());
+      }
+    }
+
+    optional_copy_base(optional_copy_base &&) = default;
+    optional_copy_base & operator=(const optional_copy_base &) = default;
+    optional_copy_base & operator=(optional_copy_base &&) = default;
+  };
+
+  template<class T, bool = 
+    std::is_trivially_move_constructible<T>::value ||
+    !std::is_move_constructible<T>::value
+  >
+  class optional_move_base : public optional_copy_base<T>
+  {
+    public:
+    using optional_copy_base<T>::optional_copy_base;
+  };
+
+  template<class T>
+  class optional_move_base<T, false> : public optional_copy_base<T>
+  {
+    public:
+    using optional_copy_base<T>::optional_copy_base;
+
+    optional_move_base() = default;
+    optional_move_base(const optional_move_base &) = default;
+
+    optional_move_base(optional_move_base && other)
+      noexcept(std::is_nothrow_move_constructible<T>::value)
+      : optional_copy_base<T>()
+    {
+      if (other.has_value())
+      {
+        this->construct(std::move(other.value_).value());
+      }
+    }
+
+    optional_move_base & operator=(const optional_move_base &) = default;
+    optional_move_base & operator=(optional_move_base &&) = default;
+  };
+
+  template<class T, bool = 
+    all<
+      std::is_trivially_copy_constructible<T>,
+      std::is_trivially_copy_assignable<T>,
+      std::is_trivially_destructible<T>
+    >::value ||
+    !all<std::is_copy_constructible<T>, std::is_copy_assignable<T>>::value
+  >
+  class optional_copy_assign_base : public optional_move_base<T>
+  {
+    public:
+    using optional_move_base<T>::optional_move_base;
+  };
+
+  template<class T>
+  class optional_copy_assign_base<T, false> : public optional_move_base<T>
+  {
+    public:
+    using optional_move_base<T>::optional_move_base;
+
+    optional_copy_assign_base() = default;
+    optional_copy_assign_base(const optional_copy_assign_base &) = default;
+    optional_copy_assign_base(optional_copy_assign_base &&) = default;
+
+    optional_copy_assign_base & operator=(const optional_copy_assign_base & other)
+    {
+      this->assign(other);
+      return *this;
+    }
+
+    optional_copy_assign_base & operator=(optional_copy_assign_base &&) = default;
+  };
+
+  template<class T, bool = 
+    all<
+      std::is_trivially_move_constructible<T>,
+      std::is_trivially_move_assignable<T>,
+      std::is_trivially_destructible<T>
+    >::value ||
+    !all<std::is_move_constructible<T>, std::is_move_assignable<T>>::value
+  >
+  class optional_move_assign_base : public optional_copy_assign_base<T>
+  {
+    public:
+    using optional_copy_assign_base<T>::optional_copy_assign_base;
+  };
+
+  template<class T>
+  class optional_move_assign_base<T, false> : public optional_copy_assign_base<T>
+  {
+    public:
+    using optional_copy_assign_base<T>::optional_copy_assign_base;
+
+    optional_move_assign_base() = default;
+    optional_move_assign_base(const optional_move_assign_base &) = default;
+    optional_move_assign_base(optional_move_assign_base &&) = default;
+    optional_move_assign_base & operator=(const optional_move_assign_base &) = default;
+
+    optional_move_assign_base & operator=(optional_move_assign_base && other)
+      noexcept(
+        std::is_nothrow_move_assignable<T>::value &&
+        std::is_nothrow_move_constructible<T>::value
+      )
+    {
+      this->assign(std::move(other));
+      return *this;
+    }
+  };
+
+  /*! Deletes the copy/move constructors and assignments that T can't
+      support.  Tag keeps nested optionals from sharing an empty base.
+  */
+  template<bool Copy, bool Move, class Tag>
+  struct enable_copy_move_ctor {};
+
+  template<class Tag>
+  struct enable_copy_move_ctor<false, true, Tag>
+  {
+    enable_copy_move_ctor() = default;
+    enable_copy_move_ctor(const enable_copy_move_ctor &) = delete;
+    enable_copy_move_ctor(enable_copy_move_ctor &&) = default;
+    enable_copy_move_ctor & operator=(const enable_copy_move_ctor &) = default;
+    enable_copy_move_ctor & operator=(enable_copy_move_ctor &&) = default;
+  };
+
+  template<class Tag>
+  struct enable_copy_move_ctor<false, false, Tag>
+  {
+    enable_copy_move_ctor() = default;
+    enable_copy_move_ctor(const enable_copy_move_ctor &) = delete;
+    enable_copy_move_ctor(enable_copy_move_ctor &&) = delete;
+    enable_copy_move_ctor & operator=(const enable_copy_move_ctor &) = default;
+    enable_copy_move_ctor & operator=(enable_copy_move_ctor &&) = default;
+  };
+
+  template<bool Copy, bool Move, class Tag>
+  struct enable_copy_move_assign {};
+
+  template<class Tag>
+  struct enable_copy_move_assign<false, true, Tag>
+  {
+    enable_copy_move_assign() = default;
+    enable_copy_move_assign(const enable_copy_move_assign &) = default;
+    enable_copy_move_assign(enable_copy_move_assign &&) = default;
+    enable_copy_move_assign & operator=(const enable_copy_move_assign &) = delete;
+    enable_copy_move_assign & operator=(enable_copy_move_assign &&) = default;
+  };
+
+  template<class Tag>
+  struct enable_copy_move_assign<false, false, Tag>
+  {
+    enable_copy_move_assign() = default;
+    enable_copy_move_assign(const enable_copy_move_assign &) = default;
+    enable_copy_move_assign(enable_copy_move_assign &&) = default;
+    enable_copy_move_assign & operator=(const enable_copy_move_assign &) = delete;
+    enable_copy_move_assign & operator=(enable_copy_move_assign &&) = delete;
+  };
+
+  template<class T>
+  using optional_enable_ctor = enable_copy_move_ctor<
+    std::is_copy_constructible<T>::value,
+    std::is_move_constructible<T>::value,
+    T
+  >;
+
+  template<class T>
+  using optional_enable_assign = enable_copy_move_assign<
+    all<std::is_copy_constructible<T>, std::is_copy_assignable<T>>::value,
+    all<std::is_move_constructible<T>, std::is_move_assignable<T>>::value,
+    T
+  >;
+
+  template<class T>
+  class optional<T, true>
+    : public optional_move_assign_base<T>
+    , private optional_enable_ctor<T>
+    , private optional_enable_assign<T>
+  {
+    using base = optional_move_assign_base<T>;
+
+    public:
+    using value_type = T;
+    
+    ///Constructor
+    //http://en.cppreference.com/w/cpp/utility/optional/optional
+    constexpr optional() noexcept
+    {
+    }
+
+    constexpr optional( std::nullopt_t ) noexcept
+      : optional()
+    {
+    }
+
+    //! The nested_empty state optional<optional<T>> uses as its sentinel
+    constexpr explicit optional( nested_empty_t ) noexcept
+      : base(nested_empty_t())
+    {
+    }
+
+    /*! 2) Copy constructor: 
+       If other contains a value, 
+       initializes the contained value as if direct-initializing 
+       (but not direct-list-initializing) 
+       an object of type T with the expression *other. 
+       If other does not contain a value, 
+       constructs an object that does not contain a value. 
+       This constructor is defined as deleted if 
+       std::is_copy_constructible_v<T> is false. 
+       It is a constexpr constructor if std::is_trivially_copy_constructible_v<T> is true.
+    */
+    optional( const optional & other ) = default;
+    
+
+    /*! 3) Move constructor: 
+        If other contains a value, 
+        initializes the contained value as if direct-initializing 
+        (but not direct-list-initializing) 
+        an object of type T with the expression std::move(*other) 
+        and does not make other empty: 
+        a moved-from optional still contains a value, 
+        but the value itself is moved from. 
+        If other does not contain a value, constructs an object that does 
+        not contain a value. 
+        This constructor does not participate in overload resolution unless 
+        std::is_move_constructible_v<T> is true. 
+        It is a constexpr constructor if std::is_trivially_move_constructible_v<T> is true.
+        3) Throws any exception thrown by the constructor of T. 
+          Has the following noexcept specification:  
+          noexcept(std::is_nothrow_move_constructible<T>::value)
+    */
+    optional( optional&& other ) = default;
+
+    /*! Converting copy constructor: 
+      If other doesn't contain a value, constructs an optional object that 
+      does not contain a value. Otherwise, constructs an optional object that 
+      contains a value, initialized as if direct-initializing 
+      (but not direct-list-initializing) an object 
+      of type T with the expression *other. 
+      
+      This constructor does not participate in overload resolution unless the following conditions are met: 
+      std::is_constructible_v<T, const U&> is true.
+      T is not constructible or convertible from any expression of 
+      type (possibly const) std::optional<U>, 
+      i.e., the following 8 type traits are all false:
+      
+      std::is_constructible_v<T, std::optional<U>&>
+      std::is_constructible_v<T, const std::optional<U>&>
+      std::is_constructible_v<T, std::optional<U>&&>
+      std::is_constructible_v<T, const std::optional<U>&&>
+      std::is_convertible_v<std::optional<U>&, T>
+      std::is_convertible_v<const std::optional<U>&, T>
+      std::is_convertible_v<std::optional<U>&&, T>
+      std::is_convertible_v<const std::optional<U>&&, T>
+
+      This constructor is explicit if and only if std::is_convertible_v<const U&, T> is false.
+    */
+    template < class U,
+      When<
+        std::is_constructible<T, const U&>,
+        Not<std::is_constructible<T, std::optional<U>&>>,
+        Not<std::is_constructible<T, const std::optional<U>&>>,
+        Not<std::is_constructible<T, std::optional<U>&&>>,
+        Not<std::is_constructible<T, const std::optional<U>&&>>,
+        Not<std::is_convertible<std::optional<U>&, T>>,
+        Not<std::is_convertible<const std::optional<U>&, T>>,
+        Not<std::is_convertible<std::optional<U>&&, T>>,
+        Not<std::is_convertible<const std::optional<U>&&, T>>,
+        Not<std::is_convertible<const U&, T>>
+      > = Enable
     >
-    explicit optional( const std::optional<U>& other );
+    explicit optional( const std::optional<U>& other )
+    {
+      if (other.has_value())
+      {
+        this->construct(*other);
+      }
+    }
     
     template < class U,
       When<
         std::is_constructible<T, const U&>,
-        std::is_constructible<T, std::optional<U>&>,
-        std::is_constructible<T, const std::optional<U>&>,
-        std::is_constructible<T, std::optional<U>&&>,
-        std::is_constructible<T, const std::optional<U>&&>,
-        std::is_convertible<std::optional<U>&, T>,
-        std::is_convertible<const std::optional<U>&, T>,
-        std::is_convertible<std::optional<U>&&, T>,
-        std::is_convertible<const std::optional<U>&&, T>,
+        Not<std::is_constructible<T, std::optional<U>&>>,
+        Not<std::is_constructible<T, const std::optional<U>&>>,
+        Not<std::is_constructible<T, std::optional<U>&&>>,
+        Not<std::is_constructible<T, const std::optional<U>&&>>,
+        Not<std::is_convertible<std::optional<U>&, T>>,
+        Not<std::is_convertible<const std::optional<U>&, T>>,
+        Not<std::is_convertible<std::optional<U>&&, T>>,
+        Not<std::is_convertible<const std::optional<U>&&, T>>,
         std::is_convertible<const U&, T>
       > = Enable
     >
-    optional( const std::optional<U>& other );
+    optional( const std::optional<U>& other )
+    {
+      if (other.has_value())
+      {
+        this->construct(*other);
+      }
+    }
 
     /*! 5) Converting move constructor: 
       If other doesn't contain a value, constructs an optional object that 
@@ -244,7 +1247,34 @@ namespace detail {
       Not<std::is_convertible<const std::optional<U>&&, T>>,
       Not<std::is_convertible<U&&, T>>
     > = Enable>
-    explicit optional( std::optional<U>&& other );
+    explicit optional( std::optional<U>&& other )
+    {
+      if (other.has_value())
+      {
+        this->construct(std::move(*other));
+      }
+    }
+
+    template < class U,
+    When<
+      std::is_constructible<T, U&&>,
+      Not<std::is_constructible<T, std::optional<U>&>>,
+      Not<std::is_constructible<T, const std::optional<U>&>>,
+      Not<std::is_constructible<T, std::optional<U>&&>>,
+      Not<std::is_constructible<T, const std::optional<U>&&>>,
+      Not<std::is_convertible<std::optional<U>&, T>>,
+      Not<std::is_convertible<const std::optional<U>&, T>>,
+      Not<std::is_convertible<std::optional<U>&&, T>>,
+      Not<std::is_convertible<const std::optional<U>&&, T>>,
+      std::is_convertible<U&&, T>
+    > = Enable>
+    optional( std::optional<U>&& other )
+    {
+      if (other.has_value())
+      {
+        this->construct(std::move(*other));
+      }
+    }
 
     /*! 6) 
     Constructs an optional object that contains a value, 
@@ -254,25 +1284,52 @@ namespace detail {
     this constructor is a constexpr constructor. 
     The function does not participate in the overload resolution unless 
     std::is_constructible_v<T, Args...> is true*/
-    //template< class... Args > 
-    //constexpr explicit optional( std::in_place_t, Args&&... args );
+    template< class... Args,
+      When<
+        std::is_constructible<T, Args&&...>
+      > = Enable
+    >
+    constexpr explicit optional( std::in_place_t, Args&&... args )
+      : base(std::in_place_t(), std::forward<Args>(args)...)
+    {
+    }
    
     /*!
-      8) Constructs an optional object that contains a value, 
+      7) Constructs an optional object that contains a value, 
       initialized as if direct-initializing (but not direct-list-initializing) 
-      an object of type T (where T = value_type) with the expression 
-      std::forward<U>(value). 
+      an object of type T from the arguments ilist, std::forward<Args>(args).... 
       If the selected constructor of T is a constexpr constructor, 
       this constructor is a constexpr constructor. 
-      This constructor does not participate in overload resolution unless 
-      std::is_constructible_v<T, U&&> is true and 
-      std::decay_t<U> is neither std::in_place_t nor std::optional<T>. 
-      This constructor is explicit if and only if std::is_convertible_v<U&&, T> is false.
+      The function does not participate in the overload resolution unless 
+      std::is_constructible_v<T, std::initializer_list<U>&, Args&&...> is true
     */
-    //template< class U, class... Args >
-    //constexpr explicit optional( std::in_place_t,
-    //                         std::initializer_list<U> ilist, 
-    //                         Args&&... args );
+    template< class U, class... Args,
+      When<
+        std::is_constructible<T, std::initializer_list<U>&, Args&&...>
+      > = Enable
+    >
+    constexpr explicit optional( std::in_place_t,
+                             std::initializer_list<U> ilist, 
+                             Args&&... args )
+      : base(std::in_place_t(), ilist, std::forward<Args>(args)...)
+    {
+    }
+
+    /*! Constructs an optional object that contains the value returned by
+        std::forward<F>(f)().  The result initialises the contained value
+        directly, so a T returned by value is never moved.  Does not
+        participate in overload resolution unless T is constructible from
+        the result of f.
+    */
+    template< class F,
+      When<
+        std::is_constructible<T, decltype(std::declval<F>()())>
+      > = Enable
+    >
+    constexpr explicit optional( std::from_invoke_t, F && f )
+      : base(std::in_place_t(), std::from_invoke_t(), std::forward<F>(f))
+    {
+    }
 
     /*!Constructs an optional object that contains a value, initialized as if 
        direct-initializing (but not direct-list-initializing) an object of type 
@@ -292,8 +1349,7 @@ namespace detail {
       > = Enable
     >
     explicit constexpr optional( U && value )
-      : initalized_(true)
-      , value_(std::forward<U>(value))
+      : base(std::in_place_t(), std::forward<U>(value))
     {
     }
     
@@ -306,11 +1362,111 @@ namespace detail {
       > = Enable
     >
     constexpr optional( U && value )
-      : initalized_(true)
-      , value_(std::forward<U>(value))
+      : base(std::in_place_t(), std::forward<U>(value))
     {
     }
       
+    ///Assignment
+    //http://en.cppreference.com/w/cpp/utility/optional/operator%3D
+    /*! Every assignment assigns in place when both sides hold a value,
+        constructs when only the source does and destroys when only
+        *this does, so T's existing resources (buffers, capacity) are
+        reused rather than rebuilt.
+    */
+    optional & operator=( std::nullopt_t ) noexcept
+    {
+      reset();
+      return *this;
+    }
+
+    optional & operator=( const optional & other ) = default;
+    optional & operator=( optional && other ) = default;
+
+    /*! Does not participate in overload resolution unless std::decay_t<U>
+        is not std::optional<T>, T is constructible and assignable from U,
+        and T is not a scalar being assigned a T (so o = {} still resets).
+    */
+    template < class U = value_type,
+      When<
+        Not<std::is_same<std::decay_t<U>, optional>>,
+        std::is_constructible<T, U>,
+        std::is_assignable<T&, U>,
+        Not<all<std::is_scalar<T>, std::is_same<T, std::decay_t<U>>>>
+      > = Enable
+    >
+    optional & operator=( U && value )
+    {
+      assign_value(std::forward<U>(value));
+      return *this;
+    }
+
+    /*! Converting copy assignment, does not participate unless T is
+        constructible and assignable from const U& and not from any form
+        of std::optional<U>.
+    */
+    template < class U,
+      When<
+        std::is_constructible<T, const U&>,
+        std::is_assignable<T&, const U&>,
+        Not<std::is_constructible<T, std::optional<U>&>>,
+        Not<std::is_constructible<T, const std::optional<U>&>>,
+        Not<std::is_constructible<T, std::optional<U>&&>>,
+        Not<std::is_constructible<T, const std::optional<U>&&>>,
+        Not<std::is_convertible<std::optional<U>&, T>>,
+        Not<std::is_convertible<const std::optional<U>&, T>>,
+        Not<std::is_convertible<std::optional<U>&&, T>>,
+        Not<std::is_convertible<const std::optional<U>&&, T>>,
+        Not<std::is_assignable<T&, std::optional<U>&>>,
+        Not<std::is_assignable<T&, const std::optional<U>&>>,
+        Not<std::is_assignable<T&, std::optional<U>&&>>,
+        Not<std::is_assignable<T&, const std::optional<U>&&>>
+      > = Enable
+    >
+    optional & operator=( const std::optional<U> & other )
+    {
+      if (other.has_value())
+      {
+        assign_value(*other);
+      }
+      else
+      {
+        reset();
+      }
+      return *this;
+    }
+
+    //! Converting move assignment, as above with U&&
+    template < class U,
+      When<
+        std::is_constructible<T, U>,
+        std::is_assignable<T&, U>,
+        Not<std::is_constructible<T, std::optional<U>&>>,
+        Not<std::is_constructible<T, const std::optional<U>&>>,
+        Not<std::is_constructible<T, std::optional<U>&&>>,
+        Not<std::is_constructible<T, const std::optional<U>&&>>,
+        Not<std::is_convertible<std::optional<U>&, T>>,
+        Not<std::is_convertible<const std::optional<U>&, T>>,
+        Not<std::is_convertible<std::optional<U>&&, T>>,
+        Not<std::is_convertible<const std::optional<U>&&, T>>,
+        Not<std::is_assignable<T&, std::optional<U>&>>,
+        Not<std::is_assignable<T&, const std::optional<U>&>>,
+        Not<std::is_assignable<T&, std::optional<U>&&>>,
+        Not<std::is_assignable<T&, const std::optional<U>&&>>
+      > = Enable
+    >
+    optional & operator=( std::optional<U> && other )
+    {
+      if (other.has_value())
+      {
+        assign_value(std::move(*other));
+      }
+      else
+      {
+        reset();
+      }
+      return *this;
+    }
+
 
    ///Observers
    //http://en.cppreference.com/w/cpp/utility/optional/operator*
@@ -326,23 +1482,23 @@ namespace detail {
 
    constexpr const T& operator*() const&
    {
-     return value_.value();
+     return this->value_.value();
    }
 
    constexpr T& operator*() &
    {
-     return value_.value();
+     return this->value_.value();
    }
 
-#if 0
    constexpr const T&& operator*() const&&
    {
+     return std::move(this->value_.value());
    }
 
    constexpr T&& operator*() &&
    {
+     return std::move(this->value_.value());
    }
-#endif
 
   //http://en.cppreference.com/w/cpp/utility/optional/operator_bool
   constexpr explicit operator bool() const noexcept
@@ -352,42 +1508,187 @@ namespace detail {
 
   constexpr bool has_value() const noexcept
   {
-    return initalized_;
+    return base::has_value();
   }
 
   //http://en.cppreference.com/w/cpp/utility/optional/value
   constexpr T & value() & 
   {
     check();
-    return value_.value();
+    return this->value_.value();
   }
 
   constexpr const T & value() const &
   {
     check();
-    return value_.value();
+    return this->value_.value();
   }
 
   constexpr T&& value() &&
   {
     check();
-    return std::move(value_.value());
+    return std::move(this->value_.value());
+  }
+
+  constexpr const T&& value() const &&
+  {
+    check();
+    return std::move(this->value_.value());
+  }
+
+  ///Monadic operations
+  /*! transform: an optional holding f(value()) if *this holds a value,
+      otherwise an empty one.  f's result initialises the new optional's
+      value directly, so chains build no intermediate optional or T.
+  */
+  template<class F>
+  auto transform( F && f ) &
+  {
+    return transform_(*this, std::forward<F>(f));
+  }
+
+  template<class F>
+  auto transform( F && f ) const&
+  {
+    return transform_(*this, std::forward<F>(f));
+  }
+
+  template<class F>
+  auto transform( F && f ) &&
+  {
+    return transform_(std::move(*this), std::forward<F>(f));
+  }
+
+  template<class F>
+  auto transform( F && f ) const&&
+  {
+    return transform_(std::move(*this), std::forward<F>(f));
+  }
+
+  /*! and_then: f(value()), which must return an optional, if *this holds
+      a value, otherwise an empty optional of that type.
+  */
+  template<class F>
+  auto and_then( F && f ) &
+  {
+    return and_then_(*this, std::forward<F>(f));
+  }
+
+  template<class F>
+  auto and_then( F && f ) const&
+  {
+    return and_then_(*this, std::forward<F>(f));
+  }
+
+  template<class F>
+  auto and_then( F && f ) &&
+  {
+    return and_then_(std::move(*this), std::forward<F>(f));
+  }
+
+  template<class F>
+  auto and_then( F && f ) const&&
+  {
+    return and_then_(std::move(*this), std::forward<F>(f));
+  }
+
+  /*! or_else: *this if it holds a value, otherwise f().  Returns
+      std::optional<T>, not this base, so f()'s result is returned as is
+      rather than sliced.
+  */
+  template<class F,
+    When<
+      std::is_convertible<call_result_t<F>, std::optional<T>>
+    > = Enable
+  >
+  std::optional<T> or_else( F && f ) const&
+  {
+    if (has_value())
+    {
+      return std::optional<T>(std::in_place, **this);
+    }
+    return std::forward<F>(f)();
+  }
+
+  template<class F,
+    When<
+      std::is_convertible<call_result_t<F>, std::optional<T>>
+    > = Enable
+  >
+  std::optional<T> or_else( F && f ) &&
+  {
+    if (has_value())
+    {
+      return std::optional<T>(std::in_place, std::move(**this));
+    }
+    return std::forward<F>(f)();
+  }
+
+  //! value_or with a lazily computed fallback, f is only called when empty
+  template<class F,
+    When<
+      std::is_convertible<call_result_t<F>, T>
+    > = Enable
+  >
+  T value_or_else( F && f ) const&
+  {
+    if (has_value())
+    {
+      return **this;
+    }
+    return std::forward<F>(f)();
+  }
+
+  template<class F,
+    When<
+      std::is_convertible<call_result_t<F>, T>
+    > = Enable
+  >
+  T value_or_else( F && f ) &&
+  {
+    if (has_value())
+    {
+      return std::move(**this);
+    }
+    return std::forward<F>(f)();
+  }
+
+  //http://en.cppreference.com/w/cpp/utility/optional/value_or
+  /*!Returns the contained value if *this has a value, otherwise 
+     default_value converted to T.  The conversion only happens on the 
+     empty path; use value_or_else when building the default is itself 
+     expensive.  The rvalue overload moves the contained value out.
+  */
+  template< class U,
+    When<
+      std::is_copy_constructible<T>,
+      std::is_convertible<U&&, T>
+    > = Enable
+  > 
+  constexpr T value_or( U&& default_value ) const&
+  {
+    if (has_value())
+    {
+      return **this;
+    }
+    return static_cast<T>(std::forward<U>(default_value));
   }
 
-  constexpr const T&& value() const &&
+  template< class U,
+    When<
+      std::is_move_constructible<T>,
+      std::is_convertible<U&&, T>
+    > = Enable
+  > 
+  constexpr T value_or( U&& default_value ) &&
   {
-    check();
-    return std::move(value_.value());
+    if (has_value())
+    {
+      return std::move(**this);
+    }
+    return static_cast<T>(std::forward<U>(default_value));
   }
 
-#if 0
-  //http://en.cppreference.com/w/cpp/utility/optional/value_or
-  template< class U > 
-  constexpr T value_or( U&& default_value ) const&;
-  template< class U > 
-  constexpr T value_or( U&& default_value ) &&;
-#endif
-
   ///Modifiers
   //http://en.cppreference.com/w/cpp/utility/optional/swap
 
@@ -413,29 +1714,7 @@ namespace detail {
       std::__is_nothrow_swappable<T>::value
     )
   {
-    if (!has_value() && !rhs.has_value())
-    {
-      return;
-    }
-    else if (has_value() && rhs.has_value())
-    {
-      using std::swap;
-      swap(**this, *rhs);
-    }
-    else if (rhs.has_value())
-    {
-      **this = std::move(*rhs);
-      initalized_ = true;
-      destruct(rhs.value());
-      rhs.initalized_ = false;
-    }
-    else
-    {
-      *rhs = std::move(**this);
-      rhs.initalized_ = true;
-      destruct(value());
-      initalized_ = false;
-    }
+    swap(rhs, std::is_trivially_copyable<T>());
   }
 
   //http://en.cppreference.com/w/cpp/utility/optional/reset
@@ -443,28 +1722,137 @@ namespace detail {
   {
     if (has_value())
     {
-      destruct(value());
-      initalized_ = false;
+      this->destroy();
     }
   }
 
-#if 0
   //http://en.cppreference.com/w/cpp/utility/optional/emplace
-  template< class... Args > 
-  T& emplace( Args&&... args );
-  template< class U, class... Args > 
-  T& emplace( std::initializer_list<U> ilist, Args&&... args );
-#endif
+  /*!Constructs the contained value in-place. 
+     If *this already contains a value before the call, 
+     the contained value is destroyed by calling its destructor. 
+     Initializes the contained value by direct-initializing 
+     (but not direct-list-initializing) with std::forward<Args>(args)... 
+     as parameters.
+     If an exception is thrown *this does not contain a value.
+  */
+  template< class... Args,
+    When<
+      std::is_constructible<T, Args&&...>
+    > = Enable
+  > 
+  T& emplace( Args&&... args )
+  {
+    reset();
+    this->construct(std::forward<Args>(args)...);
+    return this->value_.value();
+  }
+
+  template< class U, class... Args,
+    When<
+      std::is_constructible<T, std::initializer_list<U>&, Args&&...>
+    > = Enable
+  > 
+  T& emplace( std::initializer_list<U> ilist, Args&&... args )
+  {
+    reset();
+    this->construct(ilist, std::forward<Args>(args)...);
+    return this->value_.value();
+  }
+
+  /*!Destroys any contained value and then constructs a new one from 
+     the prvalue returned by std::forward<F>(f)(), without moving it.
+     If f or the construction throws *this does not contain a value.
+  */
+  template< class F,
+    When<
+      std::is_constructible<T, decltype(std::declval<F>()())>
+    > = Enable
+  > 
+  T& emplace_with( F && f )
+  {
+    reset();
+    this->construct(std::from_invoke_t(), std::forward<F>(f));
+    return this->value_.value();
+  }
     private:
-    constexpr void check() const {
-      if (!has_value())
+    template<class Self, class F,
+      class R = call_result_t<F, decltype(*std::declval<Self>())>
+    >
+    static std::optional<std::remove_cv_t<std::remove_reference_t<R>>>
+    transform_( Self && self, F && f )
+    {
+      using result = std::optional<std::remove_cv_t<std::remove_reference_t<R>>>;
+      if (!self.has_value())
       {
-        throw std::bad_optional_access();
+        return result();
       }
+      return result(std::from_invoke_t(), [&]() -> R {
+        return std::forward<F>(f)(*std::forward<Self>(self));
+      });
     }
 
-    bool initalized_;
-    storage<T> value_;
+    template<class Self, class F,
+      class R = std::remove_cv_t<std::remove_reference_t<
+        call_result_t<F, decltype(*std::declval<Self>())>
+      >>
+    >
+    static R and_then_( Self && self, F && f )
+    {
+      if (!self.has_value())
+      {
+        return R();
+      }
+      return std::forward<F>(f)(*std::forward<Self>(self));
+    }
+
+    template<class U>
+    void assign_value( U && value )
+    {
+      if (has_value())
+      {
+        this->value_.value() = std::forward<U>(value);
+      }
+      else
+      {
+        this->construct(std::forward<U>(value));
+      }
+    }
+
+    //! Trivially copyable T: swap the whole object, flag and all, no branches
+    //! Through the type, not sizeof(optional) bytes: the optional's tail
+    //! padding may hold a derived class's or a neighbouring member's data
+    void swap( optional& rhs, std::true_type ) noexcept
+    {
+      optional tmp(std::move(rhs));
+      rhs = std::move(*this);
+      *this = std::move(tmp);
+    }
+
+    void swap( optional& rhs, std::false_type )
+    {
+      if (has_value() && rhs.has_value())
+      {
+        using std::swap;
+        swap(this->value_.value(), rhs.value_.value());
+      }
+      else if (rhs.has_value())
+      {
+        this->construct(std::move(rhs.value_.value()));
+        rhs.destroy();
+      }
+      else if (has_value())
+      {
+        rhs.construct(std::move(this->value_.value()));
+        this->destroy();
+      }
+    }
+
+    constexpr void check() const {
+      if (OPTIONAL_UNLIKELY(!has_value()))
+      {
+        throw_bad_optional_access();
+      }
+    }
   };
 
   template<class T>
@@ -472,14 +1860,375 @@ namespace detail {
   {
     public:
     using optional<T, true>::optional;
+    using optional<T, true>::operator=;
+
+    optional() = default;
+    optional( const optional & ) = default;
+    optional( optional && ) = default;
+    optional & operator=( const optional & ) = default;
+    optional & operator=( optional && ) = default;
 
     ~optional()
     {
+      this->reset();
+    }
+  };
+
+  /*! optional<T&> is a checked nullable pointer: a single T*, nullptr
+      when empty, trivially copyable.  Assignment rebinds the reference,
+      it never assigns through to the referred-to object, and binding
+      to a temporary does not compile.
+  */
+  template<class T>
+  class optional<T&, true>
+  {
+    public:
+    using value_type = T&;
+
+    ///Constructor
+    constexpr optional() noexcept
+      : p_(nullptr)
+    {
+    }
+
+    constexpr optional( std::nullopt_t ) noexcept
+      : optional()
+    {
+    }
+
+    optional( const optional & other ) = default;
+    optional( optional && other ) = default;
+
+    template < class U,
+      When<
+        std::is_convertible<U*, T*>
+      > = Enable
+    >
+    constexpr optional( U & value ) noexcept
+      : p_(constexpr_addressof(value))
+    {
+    }
+
+    template < class U,
+      When<
+        Not<std::is_lvalue_reference<U>>
+      > = Enable
+    >
+    optional( U && value ) = delete;
+
+    template < class U,
+      When<
+        Not<std::is_same<T, U>>,
+        std::is_convertible<U*, T*>
+      > = Enable
+    >
+    constexpr optional( const optional<U&, true> & other ) noexcept
+      : p_(other.has_value() ? constexpr_addressof(*other) : nullptr)
+    {
+    }
+
+    ///Assignment
+    optional & operator=( const optional & other ) = default;
+    optional & operator=( optional && other ) = default;
+
+    optional & operator=( std::nullopt_t ) noexcept
+    {
+      p_ = nullptr;
+      return *this;
+    }
+
+    ///Observers
+    constexpr T* operator->() const noexcept
+    {
+      return p_;
+    }
+
+    constexpr T& operator*() const noexcept
+    {
+      return *p_;
+    }
+
+    constexpr explicit operator bool() const noexcept
+    {
+      return has_value();
+    }
+
+    constexpr bool has_value() const noexcept
+    {
+      return p_ != nullptr;
+    }
+
+    constexpr T& value() const
+    {
+      if (OPTIONAL_UNLIKELY(!has_value()))
+      {
+        throw_bad_optional_access();
+      }
+      return *p_;
+    }
+
+    ///Modifiers
+    void swap( optional & rhs ) noexcept
+    {
+      std::swap(p_, rhs.p_);
+    }
+
+    void reset() noexcept
+    {
+      p_ = nullptr;
+    }
+
+    //! Rebinds to value
+    template < class U,
+      When<
+        std::is_convertible<U*, T*>
+      > = Enable
+    >
+    T& emplace( U & value ) noexcept
+    {
+      p_ = std::addressof(value);
+      return *p_;
+    }
+
+    private:
+    T * p_;
+  };
+
+  /*! optional<optional<T>> keeps its own emptiness in the inner
+      optional's state byte, so nesting doesn't stack a second flag.
+  */
+  template<class T, bool B>
+  struct sentinel_traits<optional<T, B>,
+    Enable_When<void,
+      Not<has_sentinel<T>>,
+      Not<std::is_reference<T>>,
+      std::is_move_constructible<T>
+    >
+  >
+  {
+    static constexpr optional<T, B> empty_value() noexcept
+    {
+      return optional<T, B>(nested_empty_t());
+    }
+
+    static constexpr bool is_empty(optional<T, B> const & o) noexcept
+    {
+      return o.get_state() == state::nested_empty;
     }
   };
+
+  template<class T>
+  struct is_optional : std::false_type {};
+
+  template<class T, bool B>
+  struct is_optional<optional<T, B>> : std::true_type {};
+
+  /*! Comparisons: an empty optional equals another empty one and is less
+      than any engaged one.  The value overloads compare *x with v
+      directly, so optional<std::string> == "text" builds no temporary.
+  */
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator==( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return x.has_value() != y.has_value() ? false : !x.has_value() ? true : *x == *y;
+  }
+
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator!=( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return x.has_value() != y.has_value() ? true : !x.has_value() ? false : *x != *y;
+  }
+
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator<( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return !y.has_value() ? false : !x.has_value() ? true : *x < *y;
+  }
+
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator<=( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return !x.has_value() ? true : !y.has_value() ? false : *x <= *y;
+  }
+
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator>( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return !x.has_value() ? false : !y.has_value() ? true : *x > *y;
+  }
+
+  template<class T, bool B, class U, bool C>
+  constexpr bool operator>=( const optional<T, B> & x, const optional<U, C> & y )
+  {
+    return !y.has_value() ? true : !x.has_value() ? false : *x >= *y;
+  }
+
+  template<class T, bool B>
+  constexpr bool operator==( const optional<T, B> & x, std::nullopt_t ) noexcept
+  {
+    return !x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator==( std::nullopt_t, const optional<T, B> & x ) noexcept
+  {
+    return !x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator!=( const optional<T, B> & x, std::nullopt_t ) noexcept
+  {
+    return x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator!=( std::nullopt_t, const optional<T, B> & x ) noexcept
+  {
+    return x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator<( const optional<T, B> &, std::nullopt_t ) noexcept
+  {
+    return false;
+  }
+
+  template<class T, bool B>
+  constexpr bool operator<( std::nullopt_t, const optional<T, B> & x ) noexcept
+  {
+    return x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator<=( const optional<T, B> & x, std::nullopt_t ) noexcept
+  {
+    return !x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator<=( std::nullopt_t, const optional<T, B> & ) noexcept
+  {
+    return true;
+  }
+
+  template<class T, bool B>
+  constexpr bool operator>( const optional<T, B> & x, std::nullopt_t ) noexcept
+  {
+    return x.has_value();
+  }
+
+  template<class T, bool B>
+  constexpr bool operator>( std::nullopt_t, const optional<T, B> & ) noexcept
+  {
+    return false;
+  }
+
+  template<class T, bool B>
+  constexpr bool operator>=( const optional<T, B> &, std::nullopt_t ) noexcept
+  {
+    return true;
+  }
+
+  template<class T, bool B>
+  constexpr bool operator>=( std::nullopt_t, const optional<T, B> & x ) noexcept
+  {
+    return !x.has_value();
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator==( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x == v : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator==( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v == *x : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator!=( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x != v : true;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator!=( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v != *x : true;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator<( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x < v : true;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator<( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v < *x : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator<=( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x <= v : true;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator<=( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v <= *x : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator>( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x > v : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator>( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v > *x : true;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator>=( const optional<T, B> & x, const U & v )
+  {
+    return x.has_value() ? *x >= v : false;
+  }
+
+  template<class T, bool B, class U, When_Not<is_optional<U>> = Enable>
+  constexpr bool operator>=( const U & v, const optional<T, B> & x )
+  {
+    return x.has_value() ? v >= *x : true;
+  }
 }
 
 namespace std {
   template<class T>
   using optional = detail::optional<T, std::is_trivially_destructible<T>::value>;
 }
+
+namespace std {
+  /*! An engaged optional hashes as its value does; the empty one hashes
+      to a fixed odd constant rather than 0, which hash<int> and friends
+      give the value 0.
+  */
+  template<class T, bool B>
+  struct hash<detail::optional<T, B>>
+  {
+    static constexpr std::size_t empty_hash = static_cast<std::size_t>(0x9e3779b97f4a7c15ULL);
+
+    std::size_t operator()(const detail::optional<T, B> & o) const
+    {
+      return o.has_value() ? hash<std::remove_cv_t<std::remove_reference_t<T>>>()(*o) : empty_hash;
+    }
+  };
+
+  template<class T, bool B>
+  constexpr std::size_t hash<detail::optional<T, B>>::empty_hash;
+}
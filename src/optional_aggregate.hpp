@@ -0,0 +1,733 @@
+#pragma once
+#include "optional_compute.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/*! Null-skipping aggregations (count, sum, min, max, mean) over
+    optional_vector columns and optional<T> arrays of arithmetic T.
+    Disengaged entries are skipped through the validity mask: the values
+    under a clear bit are replaced by the identity (zero for sums, the
+    largest or smallest value for min and max) or left out of a masked
+    AVX-512 operation, with blends under AVX2 and a per-lane select for
+    types without vector code, never with a branch per element.  A NaN among the engaged
+    values makes min and max NaN, wherever it is.
+
+    Input is cut into fixed blocks of block_size elements, independent
+    of the thread count.  Threads take contiguous runs of blocks and the
+    per-block results are combined in block order, so a result does not
+    depend on how many threads computed it.  Floating point sums add
+    each 64 element word in eight fixed lanes folded pairwise, then the
+    word sums with Neumaier compensation, so they are also the same for
+    the scalar, AVX2 and AVX-512 code.
+
+    An aggregate over no engaged values is empty, like SQL's NULL.
+    threads = 0 uses std::thread::hardware_concurrency().  The threads
+    come from a pool kept for the life of the process; while another
+    call is using it, or if the system won't start them, the calling
+    thread does the work of the missing ones.
+*/
+namespace detail {
+  constexpr std::size_t block_size = 1024 * bitmap_word_bits;
+
+  //! Sum type: double for floating point T, 64 bit wrapping for integers
+  template<class T, bool = std::is_floating_point<T>::value, bool = std::is_signed<T>::value>
+  struct sum_type
+  {
+    using type = double;
+  };
+
+  template<class T>
+  struct sum_type<T, false, true>
+  {
+    using type = std::int64_t;
+  };
+
+  template<class T>
+  struct sum_type<T, false, false>
+  {
+    using type = std::uint64_t;
+  };
+
+  template<class T>
+  using sum_t = typename sum_type<T>::type;
+
+  /*! Running sum with Neumaier's compensation.  Once the sum is infinite
+      or NaN the compensation (inf - inf) means nothing, so it is left
+      alone and the sum is the result: inf for an infinite input or an
+      overflow, NaN for opposite infinities.
+  */
+  struct compensated_sum
+  {
+    void add(double v) noexcept
+    {
+      double t = s + v;
+      if (std::isfinite(t))
+      {
+        if (std::fabs(s) >= std::fabs(v))
+        {
+          c += (s - t) + v;
+        }
+        else
+        {
+          c += (v - t) + s;
+        }
+      }
+      s = t;
+    }
+
+    double value() const noexcept
+    {
+      return std::isfinite(s) ? s + c : s;
+    }
+
+    double s = 0;
+    double c = 0;
+  };
+
+  /*! Sum of the masked values of one full 64 element word: lane l adds
+      elements l, l + 8, ... in order, then the lanes fold pairwise.
+  */
+  inline double word_sum(std::uint64_t mask, const double * x) noexcept
+  {
+#if defined(__AVX512F__)
+    __m512d acc = _mm512_setzero_pd();
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      acc = _mm512_add_pd(acc, _mm512_maskz_loadu_pd(static_cast<__mmask8>(mask >> (8 * r)), x + 8 * r));
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+#elif defined(__AVX2__)
+    const __m256i bit_lo = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256i bit_hi = _mm256_setr_epi64x(16, 32, 64, 128);
+    __m256d lo = _mm256_setzero_pd();
+    __m256d hi = _mm256_setzero_pd();
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      __m256i m = _mm256_set1_epi64x(static_cast<long long>((mask >> (8 * r)) & 0xff));
+      __m256d keep_lo = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(m, bit_lo), bit_lo));
+      __m256d keep_hi = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(m, bit_hi), bit_hi));
+      lo = _mm256_add_pd(lo, _mm256_and_pd(keep_lo, _mm256_loadu_pd(x + 8 * r)));
+      hi = _mm256_add_pd(hi, _mm256_and_pd(keep_hi, _mm256_loadu_pd(x + 8 * r + 4)));
+    }
+    double lanes[8];
+    _mm256_storeu_pd(lanes, lo);
+    _mm256_storeu_pd(lanes + 4, hi);
+#else
+    double lanes[8] = {};
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      for (unsigned l = 0; l != 8; ++l)
+      {
+        unsigned i = 8 * r + l;
+        lanes[l] += (mask >> i) & 1 ? x[i] : 0.0;
+      }
+    }
+#endif
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+           ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+
+  template<class T>
+  double word_sum(std::uint64_t mask, const T * x) noexcept
+  {
+    double widened[bitmap_word_bits];
+    for (std::size_t i = 0; i != bitmap_word_bits; ++i)
+    {
+      widened[i] = static_cast<double>(x[i]);
+    }
+    return word_sum(mask, static_cast<const double *>(widened));
+  }
+
+  /*! Accumulators see each word through add(mask, values), values always
+      holding 64 readable elements, and are combined in block order by
+      merge().
+  */
+  template<class T, bool = std::is_floating_point<T>::value>
+  struct sum_acc
+  {
+    void add(std::uint64_t mask, const T * x) noexcept
+    {
+      sum.add(word_sum(mask, x));
+      count += popcount(mask);
+    }
+
+    void merge(const sum_acc & other) noexcept
+    {
+      sum.add(other.sum.value());
+      count += other.count;
+    }
+
+    double value() const noexcept
+    {
+      return sum.value();
+    }
+
+    compensated_sum sum;
+    std::size_t count = 0;
+  };
+
+  template<class T>
+  struct sum_acc<T, false>
+  {
+    using wide = std::uint64_t;
+
+    void add(std::uint64_t mask, const T * x) noexcept
+    {
+      wide s = 0;
+      for (unsigned i = 0; i != bitmap_word_bits; ++i)
+      {
+        s += (mask >> i) & 1 ? static_cast<wide>(static_cast<sum_t<T>>(x[i])) : 0;
+      }
+      sum += s;
+      count += popcount(mask);
+    }
+
+    void merge(const sum_acc & other) noexcept
+    {
+      sum += other.sum;
+      count += other.count;
+    }
+
+    sum_t<T> value() const noexcept
+    {
+      return static_cast<sum_t<T>>(sum);
+    }
+
+    wide sum = 0;
+    std::size_t count = 0;
+  };
+
+  struct greater
+  {
+    template<class T>
+    bool operator()(T x, T y) const noexcept
+    {
+      return y < x;
+    }
+  };
+
+  struct less
+  {
+    template<class T>
+    bool operator()(T x, T y) const noexcept
+    {
+      return x < y;
+    }
+  };
+
+  //! What a min (less) or max (greater) starts from and masked lanes hold
+  template<class T>
+  constexpr T extreme_identity(less) noexcept
+  {
+    return std::numeric_limits<T>::has_infinity
+      ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+  }
+
+  template<class T>
+  constexpr T extreme_identity(greater) noexcept
+  {
+    return std::numeric_limits<T>::has_infinity
+      ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+  }
+
+  template<class T>
+  bool is_nan(T v, std::true_type) noexcept
+  {
+    return std::isnan(v);
+  }
+
+  template<class T>
+  bool is_nan(T, std::false_type) noexcept
+  {
+    return false;
+  }
+
+  template<class T, class Less>
+  T fold_lanes(const T * lanes, std::size_t count, Less before) noexcept
+  {
+    T best = lanes[0];
+    for (std::size_t l = 1; l != count; ++l)
+    {
+      best = before(lanes[l], best) ? lanes[l] : best;
+    }
+    return best;
+  }
+
+  /*! Min (less) or max (greater) of the masked values of one full word,
+      the masked-off ones replaced by the identity: eight lanes, no
+      branch on the mask.  nan is set if a masked value is NaN.
+  */
+  template<class T, class Less>
+  T word_extreme(std::uint64_t mask, const T * x, Less before, bool & nan) noexcept
+  {
+    const T identity = extreme_identity<T>(before);
+    T lanes[8] = {identity, identity, identity, identity, identity, identity, identity, identity};
+    bool unordered = false;
+    for (unsigned i = 0; i != bitmap_word_bits; ++i)
+    {
+      T v = (mask >> i) & 1 ? x[i] : identity;
+      unordered |= is_nan(v, std::is_floating_point<T>());
+      lanes[i % 8] = before(v, lanes[i % 8]) ? v : lanes[i % 8];
+    }
+    nan |= unordered;
+    return fold_lanes(lanes, 8, before);
+  }
+
+#if defined(__AVX512F__)
+  inline __m512d extreme(__m512d a, __mmask8 k, __m512d b, less) noexcept { return _mm512_mask_min_pd(a, k, a, b); }
+  inline __m512d extreme(__m512d a, __mmask8 k, __m512d b, greater) noexcept { return _mm512_mask_max_pd(a, k, a, b); }
+  inline __m512 extreme(__m512 a, __mmask16 k, __m512 b, less) noexcept { return _mm512_mask_min_ps(a, k, a, b); }
+  inline __m512 extreme(__m512 a, __mmask16 k, __m512 b, greater) noexcept { return _mm512_mask_max_ps(a, k, a, b); }
+
+  //! Masked min and max leave the masked-off lanes at what they were
+  template<class Less>
+  double word_extreme(std::uint64_t mask, const double * x, Less before, bool & nan) noexcept
+  {
+    __m512d acc = _mm512_set1_pd(extreme_identity<double>(before));
+    __mmask8 unordered = 0;
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      __mmask8 k = static_cast<__mmask8>(mask >> (8 * r));
+      __m512d v = _mm512_loadu_pd(x + 8 * r);
+      unordered |= _mm512_mask_cmp_pd_mask(k, v, v, _CMP_UNORD_Q);
+      acc = extreme(acc, k, v, before);
+    }
+    nan |= unordered != 0;
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+    return fold_lanes(lanes, 8, before);
+  }
+
+  template<class Less>
+  float word_extreme(std::uint64_t mask, const float * x, Less before, bool & nan) noexcept
+  {
+    __m512 acc = _mm512_set1_ps(extreme_identity<float>(before));
+    __mmask16 unordered = 0;
+    for (unsigned r = 0; r != 4; ++r)
+    {
+      __mmask16 k = static_cast<__mmask16>(mask >> (16 * r));
+      __m512 v = _mm512_loadu_ps(x + 16 * r);
+      unordered |= _mm512_mask_cmp_ps_mask(k, v, v, _CMP_UNORD_Q);
+      acc = extreme(acc, k, v, before);
+    }
+    nan |= unordered != 0;
+    float lanes[16];
+    _mm512_storeu_ps(lanes, acc);
+    return fold_lanes(lanes, 16, before);
+  }
+#elif defined(__AVX2__)
+  inline __m256d extreme(__m256d a, __m256d b, less) noexcept { return _mm256_min_pd(a, b); }
+  inline __m256d extreme(__m256d a, __m256d b, greater) noexcept { return _mm256_max_pd(a, b); }
+  inline __m256 extreme(__m256 a, __m256 b, less) noexcept { return _mm256_min_ps(a, b); }
+  inline __m256 extreme(__m256 a, __m256 b, greater) noexcept { return _mm256_max_ps(a, b); }
+
+  //! The masked-off lanes are blended to the identity
+  template<class Less>
+  double word_extreme(std::uint64_t mask, const double * x, Less before, bool & nan) noexcept
+  {
+    const __m256i bit = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256d identity = _mm256_set1_pd(extreme_identity<double>(before));
+    __m256d acc = identity;
+    int unordered = 0;
+    for (unsigned r = 0; r != 16; ++r)
+    {
+      __m256i m = _mm256_set1_epi64x(static_cast<long long>((mask >> (4 * r)) & 0xf));
+      __m256d keep = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(m, bit), bit));
+      __m256d v = _mm256_blendv_pd(identity, _mm256_loadu_pd(x + 4 * r), keep);
+      unordered |= _mm256_movemask_pd(_mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+      acc = extreme(acc, v, before);
+    }
+    nan |= unordered != 0;
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return fold_lanes(lanes, 4, before);
+  }
+
+  template<class Less>
+  float word_extreme(std::uint64_t mask, const float * x, Less before, bool & nan) noexcept
+  {
+    const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 identity = _mm256_set1_ps(extreme_identity<float>(before));
+    __m256 acc = identity;
+    int unordered = 0;
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      __m256i m = _mm256_set1_epi32(static_cast<int>((mask >> (8 * r)) & 0xff));
+      __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(m, bit), bit));
+      __m256 v = _mm256_blendv_ps(identity, _mm256_loadu_ps(x + 8 * r), keep);
+      unordered |= _mm256_movemask_ps(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+      acc = extreme(acc, v, before);
+    }
+    nan |= unordered != 0;
+    float lanes[8];
+    _mm256_storeu_ps(lanes, acc);
+    return fold_lanes(lanes, 8, before);
+  }
+#endif
+
+  /*! Min (less) or max (greater).  A NaN anywhere among the engaged
+      values makes the result NaN, whatever its position.
+  */
+  template<class T, class Less>
+  struct extreme_acc
+  {
+    void add(std::uint64_t mask, const T * x) noexcept
+    {
+      if (mask)
+      {
+        take(word_extreme(mask, x, Less(), nan));
+      }
+    }
+
+    void merge(const extreme_acc & other) noexcept
+    {
+      if (other.seen)
+      {
+        take(other.best);
+      }
+      nan |= other.nan;
+    }
+
+    void take(T v) noexcept
+    {
+      best = Less()(v, best) ? v : best;
+      seen = true;
+    }
+
+    T value() const noexcept
+    {
+      return nan ? std::numeric_limits<T>::quiet_NaN() : best;
+    }
+
+    T best = extreme_identity<T>(Less());
+    bool seen = false;
+    bool nan = false;
+  };
+
+  //! Feeds the words [first, last) of a bitmap column to acc
+  template<class T, class Acc>
+  void visit_words(const T * values, const std::uint64_t * bitmap, std::size_t n,
+                   std::size_t first, std::size_t last, Acc & acc) noexcept
+  {
+    for (std::size_t w = first; w != last; ++w)
+    {
+      std::size_t base = w * bitmap_word_bits;
+      if (base + bitmap_word_bits <= n)
+      {
+        acc.add(bitmap[w], values + base);
+      }
+      else
+      {
+        // the last word may stop short of the value array's end
+        T tail[bitmap_word_bits] = {};
+        std::memcpy(tail, values + base, (n - base) * sizeof(T));
+        acc.add(bitmap[w] & tail_mask(n), tail);
+      }
+    }
+  }
+
+  //! Same for an optional<T> array, gathering each word's values and mask
+  template<class T, bool B, class Acc>
+  void visit_words(const optional<T, B> * values, std::size_t n,
+                   std::size_t first, std::size_t last, Acc & acc) noexcept
+  {
+    for (std::size_t w = first; w != last; ++w)
+    {
+      std::size_t base = w * bitmap_word_bits;
+      std::size_t count = std::min(bitmap_word_bits, n - base);
+      T word[bitmap_word_bits] = {};
+      std::uint64_t mask = 0;
+      for (std::size_t i = 0; i != count; ++i)
+      {
+        bool engaged = values[base + i].has_value();
+        word[i] = engaged ? *values[base + i] : T();
+        mask |= std::uint64_t(engaged) << i;
+      }
+      acc.add(mask, word);
+    }
+  }
+
+  /*! Worker threads shared by every reduction, started the first time
+      a call needs them and joined at exit.  One run() uses the pool at a
+      time; a concurrent or nested run() does its jobs on its own thread.
+  */
+  class thread_pool
+  {
+    public:
+    thread_pool() = default;
+    thread_pool(const thread_pool &) = delete;
+    thread_pool & operator=(const thread_pool &) = delete;
+
+    ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wake_.notify_all();
+      for (auto & worker : workers_)
+      {
+        worker.join();
+      }
+    }
+
+    static thread_pool & shared()
+    {
+      static thread_pool pool;
+      return pool;
+    }
+
+    //! Calls job(i) for each i in [0, jobs) on the calling thread and up
+    //! to jobs - 1 workers, and returns when all calls have.  job must
+    //! not throw.
+    template<class Job>
+    void run(std::size_t jobs, Job & job)
+    {
+      std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+      if (!busy)
+      {
+        for (std::size_t i = 0; i != jobs; ++i)
+        {
+          job(i);
+        }
+        return;
+      }
+      start(jobs - 1);
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      call_ = [](void * j, std::size_t i) { (*static_cast<Job *>(j))(i); };
+      job_ = &job;
+      jobs_ = jobs;
+      next_ = 0;
+      done_ = 0;
+      wake_.notify_all();
+      while (next_ != jobs_)
+      {
+        take(lock);
+      }
+      finished_.wait(lock, [this] { return done_ == jobs_; });
+    }
+
+    private:
+    //! Starts workers up to n, as many as the system allows
+    void start(std::size_t n)
+    {
+      while (workers_.size() < n)
+      {
+#if !OPTIONAL_NO_EXCEPTIONS
+        try
+        {
+#endif
+          workers_.emplace_back([this] { work(); });
+#if !OPTIONAL_NO_EXCEPTIONS
+        }
+        catch (const std::system_error &)
+        {
+          return;
+        }
+#endif
+      }
+    }
+
+    void work()
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;)
+      {
+        wake_.wait(lock, [this] { return stop_ || next_ != jobs_; });
+        if (stop_)
+        {
+          return;
+        }
+        take(lock);
+      }
+    }
+
+    //! Runs the next job with the lock released
+    void take(std::unique_lock<std::mutex> & lock)
+    {
+      std::size_t i = next_++;
+      lock.unlock();
+      call_(job_, i);
+      lock.lock();
+      if (++done_ == jobs_)
+      {
+        finished_.notify_one();
+      }
+    }
+
+    std::mutex busy_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    std::vector<std::thread> workers_;
+    void (*call_)(void *, std::size_t) = nullptr;
+    void * job_ = nullptr;
+    std::size_t jobs_ = 0;
+    std::size_t next_ = 0;
+    std::size_t done_ = 0;
+    bool stop_ = false;
+  };
+
+  /*! Runs visit(first_word, last_word, acc) over every block, on up to
+      threads threads, and merges the block results in order.
+  */
+  template<class Acc, class Visit>
+  Acc reduce(std::size_t n, unsigned threads, Visit visit)
+  {
+    const std::size_t words = bitmap_words(n);
+    const std::size_t block_words = block_size / bitmap_word_bits;
+    const std::size_t blocks = (words + block_words - 1) / block_words;
+    std::vector<Acc> partial(blocks);
+    auto run = [&](std::size_t first, std::size_t last) {
+      for (std::size_t b = first; b != last; ++b)
+      {
+        visit(b * block_words, std::min(words, (b + 1) * block_words), partial[b]);
+      }
+    };
+
+    if (!threads)
+    {
+      threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, blocks));
+    if (threads <= 1)
+    {
+      run(0, blocks);
+    }
+    else
+    {
+      auto job = [&](std::size_t t) {
+        run(blocks * t / threads, blocks * (t + 1) / threads);
+      };
+      thread_pool::shared().run(threads, job);
+    }
+
+    Acc total;
+    for (auto const & p : partial)
+    {
+      total.merge(p);
+    }
+    return total;
+  }
+
+  template<class Acc, class T>
+  Acc reduce(const std::optional_vector<T> & v, unsigned threads)
+  {
+    const T * values = v.data();
+    const std::uint64_t * bitmap = v.bitmap();
+    const std::size_t n = v.size();
+    return reduce<Acc>(n, threads, [=](std::size_t first, std::size_t last, Acc & acc) {
+      visit_words(values, bitmap, n, first, last, acc);
+    });
+  }
+
+  template<class Acc, class T, bool B>
+  Acc reduce(const optional<T, B> * first, const optional<T, B> * last, unsigned threads)
+  {
+    const std::size_t n = static_cast<std::size_t>(last - first);
+    return reduce<Acc>(n, threads, [=](std::size_t w0, std::size_t w1, Acc & acc) {
+      visit_words(first, n, w0, w1, acc);
+    });
+  }
+
+  template<class Acc>
+  std::optional<decltype(std::declval<Acc>().value())> sum_of(const Acc & acc)
+  {
+    using R = decltype(acc.value());
+    return acc.count ? std::optional<R>(acc.value()) : std::optional<R>();
+  }
+
+  template<class T, class Acc>
+  std::optional<T> extreme_of(const Acc & acc)
+  {
+    return acc.seen ? std::optional<T>(acc.value()) : std::optional<T>();
+  }
+
+  template<class Acc>
+  std::optional<double> mean_of(const Acc & acc)
+  {
+    return acc.count
+      ? std::optional<double>(static_cast<double>(acc.value()) / static_cast<double>(acc.count))
+      : std::optional<double>();
+  }
+}
+
+namespace std {
+namespace compute {
+  ///optional_vector columns
+
+  template<class T>
+  std::size_t count( const optional_vector<T> & v ) noexcept
+  {
+    return count_engaged(v);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<detail::sum_t<T>> sum( const optional_vector<T> & v, unsigned threads = 0 )
+  {
+    return detail::sum_of(detail::reduce<detail::sum_acc<T>>(v, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<T> min( const optional_vector<T> & v, unsigned threads = 0 )
+  {
+    return detail::extreme_of<T>(detail::reduce<detail::extreme_acc<T, detail::less>>(v, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<T> max( const optional_vector<T> & v, unsigned threads = 0 )
+  {
+    return detail::extreme_of<T>(detail::reduce<detail::extreme_acc<T, detail::greater>>(v, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<double> mean( const optional_vector<T> & v, unsigned threads = 0 )
+  {
+    return detail::mean_of(detail::reduce<detail::sum_acc<T>>(v, threads));
+  }
+
+  ///optional<T> arrays
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  std::size_t count( const optional<T> * first, const optional<T> * last ) noexcept
+  {
+    return count_engaged(first, last);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<detail::sum_t<T>> sum( const optional<T> * first, const optional<T> * last,
+                                  unsigned threads = 0 )
+  {
+    return detail::sum_of(detail::reduce<detail::sum_acc<T>>(first, last, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<T> min( const optional<T> * first, const optional<T> * last, unsigned threads = 0 )
+  {
+    return detail::extreme_of<T>(detail::reduce<detail::extreme_acc<T, detail::less>>(first, last, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<T> max( const optional<T> * first, const optional<T> * last, unsigned threads = 0 )
+  {
+    return detail::extreme_of<T>(detail::reduce<detail::extreme_acc<T, detail::greater>>(first, last, threads));
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional<double> mean( const optional<T> * first, const optional<T> * last, unsigned threads = 0 )
+  {
+    return detail::mean_of(detail::reduce<detail::sum_acc<T>>(first, last, threads));
+  }
+}
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include "optional_compute.hpp"
+#include "optional_logic.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/*! Column against scalar comparisons for arithmetic T, straight into the
+    two bitmaps of an optional_bool_vector: validity is the column's, the
+    result bit is the comparison where valid.  A 64 row word of results
+    comes from AVX-512 compare masks (float, double and every integer
+    width, 8 and 16 bit ones only with AVX512BW) or AVX2 compares and movemasks (32 and 64 bit integers,
+    float, double), else a scalar loop.  Floating point compares follow
+    C++: NaN is unordered, so only != holds.
+*/
+namespace std {
+namespace compute {
+  enum class comparison
+  {
+    equal,
+    not_equal,
+    less,
+    less_equal,
+    greater,
+    greater_equal
+  };
+}
+}
+
+namespace detail {
+  //! Same size and signedness integer, to pick the compare instruction
+  template<std::size_t Size, bool Signed> struct fixed_int;
+  template<> struct fixed_int<1, true> { using type = std::int8_t; };
+  template<> struct fixed_int<1, false> { using type = std::uint8_t; };
+  template<> struct fixed_int<2, true> { using type = std::int16_t; };
+  template<> struct fixed_int<2, false> { using type = std::uint16_t; };
+  template<> struct fixed_int<4, true> { using type = std::int32_t; };
+  template<> struct fixed_int<4, false> { using type = std::uint32_t; };
+  template<> struct fixed_int<8, true> { using type = std::int64_t; };
+  template<> struct fixed_int<8, false> { using type = std::uint64_t; };
+
+  template<class T, bool = std::is_integral<T>::value>
+  struct lane_type
+  {
+    using type = T;
+  };
+
+  template<class T>
+  struct lane_type<T, true> : fixed_int<sizeof(T), std::is_signed<T>::value> {};
+
+  template<class T>
+  using lane_t = typename lane_type<T>::type;
+
+  template<class Op, class T>
+  std::uint64_t compare_scalar(const T * x, T s, std::size_t count) noexcept
+  {
+    std::uint64_t bits = 0;
+    for (std::size_t j = 0; j != count; ++j)
+    {
+      bits |= std::uint64_t(Op::apply(x[j], s)) << j;
+    }
+    return bits;
+  }
+
+#if defined(__AVX512F__)
+  /*! _CMP_* and _MM_CMPINT_* predicates of each op, ordered and
+      non-signalling except != which is true for NaN
+  */
+  template<class Op> struct predicate;
+  template<> struct predicate<eq_op> { static constexpr int fp = _CMP_EQ_OQ, integer = _MM_CMPINT_EQ; };
+  template<> struct predicate<ne_op> { static constexpr int fp = _CMP_NEQ_UQ, integer = _MM_CMPINT_NE; };
+  template<> struct predicate<lt_op> { static constexpr int fp = _CMP_LT_OQ, integer = _MM_CMPINT_LT; };
+  template<> struct predicate<le_op> { static constexpr int fp = _CMP_LE_OQ, integer = _MM_CMPINT_LE; };
+  template<> struct predicate<gt_op> { static constexpr int fp = _CMP_GT_OQ, integer = _MM_CMPINT_NLE; };
+  template<> struct predicate<ge_op> { static constexpr int fp = _CMP_GE_OQ, integer = _MM_CMPINT_NLT; };
+
+  //! One register's compare mask, p pointing at 64 bytes
+  template<class Op> std::uint64_t compare_register(const double * p, double s) noexcept
+  { return _mm512_cmp_pd_mask(_mm512_loadu_pd(p), _mm512_set1_pd(s), predicate<Op>::fp); }
+  template<class Op> std::uint64_t compare_register(const float * p, float s) noexcept
+  { return _mm512_cmp_ps_mask(_mm512_loadu_ps(p), _mm512_set1_ps(s), predicate<Op>::fp); }
+  template<class Op> std::uint64_t compare_register(const std::int64_t * p, std::int64_t s) noexcept
+  { return _mm512_cmp_epi64_mask(_mm512_loadu_si512(p), _mm512_set1_epi64(s), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::uint64_t * p, std::uint64_t s) noexcept
+  { return _mm512_cmp_epu64_mask(_mm512_loadu_si512(p), _mm512_set1_epi64(static_cast<long long>(s)), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::int32_t * p, std::int32_t s) noexcept
+  { return _mm512_cmp_epi32_mask(_mm512_loadu_si512(p), _mm512_set1_epi32(s), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::uint32_t * p, std::uint32_t s) noexcept
+  { return _mm512_cmp_epu32_mask(_mm512_loadu_si512(p), _mm512_set1_epi32(static_cast<int>(s)), predicate<Op>::integer); }
+#if defined(__AVX512BW__)
+  template<class Op> std::uint64_t compare_register(const std::int16_t * p, std::int16_t s) noexcept
+  { return _mm512_cmp_epi16_mask(_mm512_loadu_si512(p), _mm512_set1_epi16(s), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::uint16_t * p, std::uint16_t s) noexcept
+  { return _mm512_cmp_epu16_mask(_mm512_loadu_si512(p), _mm512_set1_epi16(static_cast<short>(s)), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::int8_t * p, std::int8_t s) noexcept
+  { return _mm512_cmp_epi8_mask(_mm512_loadu_si512(p), _mm512_set1_epi8(s), predicate<Op>::integer); }
+  template<class Op> std::uint64_t compare_register(const std::uint8_t * p, std::uint8_t s) noexcept
+  { return _mm512_cmp_epu8_mask(_mm512_loadu_si512(p), _mm512_set1_epi8(static_cast<char>(s)), predicate<Op>::integer); }
+#endif
+
+  constexpr std::size_t register_bytes = 64;
+
+  //! 8 and 16 bit compares are AVX512BW, without it they stay scalar
+  template<class T>
+  using simd_comparable = std::integral_constant<bool,
+    !std::is_same<T, long double>::value
+#if !defined(__AVX512BW__)
+    && sizeof(T) >= 4
+#endif
+  >;
+#elif defined(__AVX2__)
+  template<class Op> struct predicate;
+  template<> struct predicate<eq_op> { static constexpr int fp = _CMP_EQ_OQ; };
+  template<> struct predicate<ne_op> { static constexpr int fp = _CMP_NEQ_UQ; };
+  template<> struct predicate<lt_op> { static constexpr int fp = _CMP_LT_OQ; };
+  template<> struct predicate<le_op> { static constexpr int fp = _CMP_LE_OQ; };
+  template<> struct predicate<gt_op> { static constexpr int fp = _CMP_GT_OQ; };
+  template<> struct predicate<ge_op> { static constexpr int fp = _CMP_GE_OQ; };
+
+  /*! AVX2 only has signed == and >, the rest are built from them:
+      x < s is s > x, x <= s is !(x > s), and so on.
+  */
+  template<class Op> struct integer_predicate;
+  template<> struct integer_predicate<eq_op> { static constexpr bool greater = false, swap = false, negate = false; };
+  template<> struct integer_predicate<ne_op> { static constexpr bool greater = false, swap = false, negate = true; };
+  template<> struct integer_predicate<lt_op> { static constexpr bool greater = true, swap = true, negate = false; };
+  template<> struct integer_predicate<le_op> { static constexpr bool greater = true, swap = false, negate = true; };
+  template<> struct integer_predicate<gt_op> { static constexpr bool greater = true, swap = false, negate = false; };
+  template<> struct integer_predicate<ge_op> { static constexpr bool greater = true, swap = true, negate = true; };
+
+  inline __m256i cmpeq(__m256i a, __m256i b, std::int64_t) noexcept { return _mm256_cmpeq_epi64(a, b); }
+  inline __m256i cmpgt(__m256i a, __m256i b, std::int64_t) noexcept { return _mm256_cmpgt_epi64(a, b); }
+  inline __m256i cmpeq(__m256i a, __m256i b, std::int32_t) noexcept { return _mm256_cmpeq_epi32(a, b); }
+  inline __m256i cmpgt(__m256i a, __m256i b, std::int32_t) noexcept { return _mm256_cmpgt_epi32(a, b); }
+
+  template<class Op, class T>
+  unsigned compare_integers(const T * p, T s) noexcept
+  {
+    using P = integer_predicate<Op>;
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i y = sizeof(T) == 8 ? _mm256_set1_epi64x(s) : _mm256_set1_epi32(static_cast<int>(s));
+    __m256i m = P::greater ? (P::swap ? cmpgt(y, x, T()) : cmpgt(x, y, T())) : cmpeq(x, y, T());
+    unsigned bits = sizeof(T) == 8
+      ? static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)))
+      : static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    return P::negate ? ~bits & ((1U << (32 / sizeof(T))) - 1) : bits;
+  }
+
+  template<class Op> std::uint64_t compare_register(const double * p, double s) noexcept
+  { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p), _mm256_set1_pd(s), predicate<Op>::fp))); }
+  template<class Op> std::uint64_t compare_register(const float * p, float s) noexcept
+  { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(p), _mm256_set1_ps(s), predicate<Op>::fp))); }
+  template<class Op> std::uint64_t compare_register(const std::int64_t * p, std::int64_t s) noexcept
+  { return compare_integers<Op>(p, s); }
+  template<class Op> std::uint64_t compare_register(const std::int32_t * p, std::int32_t s) noexcept
+  { return compare_integers<Op>(p, s); }
+
+  constexpr std::size_t register_bytes = 32;
+
+  template<class T>
+  using simd_comparable = std::integral_constant<bool,
+    std::is_same<T, double>::value || std::is_same<T, float>::value ||
+    std::is_same<T, std::int64_t>::value || std::is_same<T, std::int32_t>::value>;
+#else
+  constexpr std::size_t register_bytes = 0;
+
+  template<class T>
+  using simd_comparable = std::false_type;
+
+  template<class Op, class T>
+  std::uint64_t compare_register(const T *, T) noexcept;
+#endif
+
+  template<class Op, class T>
+  std::uint64_t compare_word(const T * x, T s, std::true_type) noexcept
+  {
+    constexpr std::size_t lanes = register_bytes / sizeof(T);
+    std::uint64_t bits = 0;
+    for (std::size_t r = 0; r != bitmap_word_bits / lanes; ++r)
+    {
+      bits |= compare_register<Op>(x + r * lanes, s) << (r * lanes);
+    }
+    return bits;
+  }
+
+  template<class Op, class T>
+  std::uint64_t compare_word(const T * x, T s, std::false_type) noexcept
+  {
+    return compare_scalar<Op>(x, s, bitmap_word_bits);
+  }
+
+  //! The 64 results of one full word
+  template<class Op, class T>
+  std::uint64_t compare_word(const T * x, T s) noexcept
+  {
+    return compare_word<Op>(x, s, simd_comparable<T>());
+  }
+
+  template<class Op, class T>
+  void compare(const T * values, const std::uint64_t * bitmap, std::size_t n, T scalar,
+               std::uint64_t * valid, std::uint64_t * result) noexcept
+  {
+    using L = lane_t<T>;
+    const L * x = reinterpret_cast<const L *>(values);
+    const L s = static_cast<L>(scalar);
+    const std::size_t words = bitmap_words(n);
+    for (std::size_t w = 0; w != words; ++w)
+    {
+      std::size_t base = w * bitmap_word_bits;
+      std::uint64_t bits = base + bitmap_word_bits <= n
+        ? compare_word<Op>(x + base, s)
+        : compare_scalar<Op>(x + base, s, n - base);
+      valid[w] = bitmap[w];
+      result[w] = bits & bitmap[w];
+    }
+    if (words)
+    {
+      valid[words - 1] &= tail_mask(n);
+      result[words - 1] &= tail_mask(n);
+    }
+  }
+}
+
+namespace std {
+namespace compute {
+  /*! values[i] op scalar into valid and result, bitmap_words(n) words
+      each, for the rows of bitmap; bits past n are ignored.
+  */
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void compare( const T * values, const std::uint64_t * bitmap, std::size_t n,
+                comparison op, T scalar, std::uint64_t * valid, std::uint64_t * result ) noexcept
+  {
+    switch (op)
+    {
+    case comparison::equal:
+      return detail::compare<detail::eq_op>(values, bitmap, n, scalar, valid, result);
+    case comparison::not_equal:
+      return detail::compare<detail::ne_op>(values, bitmap, n, scalar, valid, result);
+    case comparison::less:
+      return detail::compare<detail::lt_op>(values, bitmap, n, scalar, valid, result);
+    case comparison::less_equal:
+      return detail::compare<detail::le_op>(values, bitmap, n, scalar, valid, result);
+    case comparison::greater:
+      return detail::compare<detail::gt_op>(values, bitmap, n, scalar, valid, result);
+    case comparison::greater_equal:
+      return detail::compare<detail::ge_op>(values, bitmap, n, scalar, valid, result);
+    }
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_bool_vector compare( const optional_vector<T> & v, comparison op, T scalar )
+  {
+    optional_bool_vector out(v.size());
+    compare(v.data(), v.bitmap(), v.size(), op, scalar,
+            detail::bool_vector_access::bitmap(out), detail::bool_vector_access::values(out));
+    return out;
+  }
+}
+}
@@ -0,0 +1,572 @@
+#pragma once
+#include "optional.hpp"
+#include "optional_vector.hpp"
+#include "optional_kernels.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/*! SQL style element-wise operations over optional columns of arithmetic
+    T: a result is empty wherever an input is.  Over optional_vector the
+    validity is computed a bitmap word at a time and the values in one
+    branch free pass over every slot, engaged or not, which the compiler
+    is free to vectorise; fill_null and coalesce select with AVX-512 or
+    AVX2 blends when built for them.  Over optional<T> arrays each element
+    is a branch free select.
+
+    Integer arithmetic wraps instead of overflowing, and an integer
+    division by zero (or of the minimum by -1) gives an empty result.
+    Columns passed together must be the same size, or std::length_error
+    is thrown.
+*/
+namespace detail {
+  template<class T>
+  struct identity
+  {
+    using type = T;
+  };
+
+  //! Unsigned type integer arithmetic is done in so overflow wraps
+  template<class T, bool = std::is_integral<T>::value>
+  struct wrapping
+  {
+    using type = T;
+  };
+
+  template<class T>
+  struct wrapping<T, true>
+  {
+    using type = std::common_type_t<std::make_unsigned_t<T>, unsigned>;
+  };
+
+  template<class T>
+  using wrapping_t = typename wrapping<T>::type;
+
+  /*! Each op gives apply(x, y), the value for any pair of T, and
+      defined(x, y), false where the result must be empty instead.
+  */
+  struct always_defined
+  {
+    static constexpr bool checked = false;
+
+    template<class T>
+    static constexpr bool defined(T, T) noexcept
+    {
+      return true;
+    }
+  };
+
+  struct add_op : always_defined
+  {
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return static_cast<T>(static_cast<wrapping_t<T>>(x) + static_cast<wrapping_t<T>>(y));
+    }
+  };
+
+  struct sub_op : always_defined
+  {
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return static_cast<T>(static_cast<wrapping_t<T>>(x) - static_cast<wrapping_t<T>>(y));
+    }
+  };
+
+  struct mul_op : always_defined
+  {
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return static_cast<T>(static_cast<wrapping_t<T>>(x) * static_cast<wrapping_t<T>>(y));
+    }
+  };
+
+  struct div_op
+  {
+    static constexpr bool checked = true;
+
+    template<class T>
+    static bool defined(T x, T y) noexcept
+    {
+      return !std::is_integral<T>::value ||
+        (y != T(0) && !(std::is_signed<T>::value &&
+                        x == std::numeric_limits<T>::lowest() && y == static_cast<T>(-1)));
+    }
+
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return defined(x, y) ? x / y : T(0);
+    }
+  };
+
+  struct min_op : always_defined
+  {
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return y < x ? y : x;
+    }
+  };
+
+  struct max_op : always_defined
+  {
+    template<class T>
+    static T apply(T x, T y) noexcept
+    {
+      return x < y ? y : x;
+    }
+  };
+
+  struct eq_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x == y;
+    }
+  };
+
+  struct ne_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x != y;
+    }
+  };
+
+  struct lt_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x < y;
+    }
+  };
+
+  struct le_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x <= y;
+    }
+  };
+
+  struct gt_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x > y;
+    }
+  };
+
+  struct ge_op : always_defined
+  {
+    template<class T>
+    static bool apply(T x, T y) noexcept
+    {
+      return x >= y;
+    }
+  };
+
+  template<class Op, class T>
+  using op_result_t = decltype(Op::apply(std::declval<T>(), std::declval<T>()));
+
+  template<class T>
+  using Arithmetic = all<std::is_arithmetic<T>, Not<std::is_same<T, bool>>>;
+
+  template<class Op, class T>
+  std::optional_vector<op_result_t<Op, T>> binary(const std::optional_vector<T> & a,
+                                                  const std::optional_vector<T> & b)
+  {
+    using R = op_result_t<Op, T>;
+    require_same_size(a.size(), b.size());
+    const std::size_t n = a.size();
+    std::optional_vector<R> out(n);
+    R * o = out.data();
+    const T * x = a.data();
+    const T * y = b.data();
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      o[i] = Op::apply(x[i], y[i]);
+    }
+
+    std::uint64_t * bits = out.bitmap();
+    const std::uint64_t * abits = a.bitmap();
+    const std::uint64_t * bbits = b.bitmap();
+    const std::size_t words = bitmap_words(n);
+    for (std::size_t w = 0; w != words; ++w)
+    {
+      bits[w] = abits[w] & bbits[w];
+    }
+    if (Op::checked)
+    {
+      for (std::size_t w = 0; w != words; ++w)
+      {
+        std::uint64_t defined = 0;
+        std::size_t base = w * bitmap_word_bits;
+        std::size_t count = std::min(bitmap_word_bits, n - base);
+        for (std::size_t j = 0; j != count; ++j)
+        {
+          defined |= std::uint64_t(Op::defined(x[base + j], y[base + j])) << j;
+        }
+        bits[w] &= defined;
+      }
+    }
+    if (words)
+    {
+      bits[words - 1] &= tail_mask(n);
+    }
+    return out;
+  }
+
+  template<class Op, class T>
+  void binary(const std::optional<T> * a, const std::optional<T> * b, std::size_t n,
+              std::optional<op_result_t<Op, T>> * out)
+  {
+    using R = op_result_t<Op, T>;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      T x = a[i].has_value() ? *a[i] : T(0);
+      T y = b[i].has_value() ? *b[i] : T(0);
+      bool valid = a[i].has_value() & b[i].has_value() & Op::defined(x, y);
+      R r = Op::apply(x, y);
+      out[i] = valid ? std::optional<R>(r) : std::optional<R>();
+    }
+  }
+
+  /*! out[j] = bit j of mask ? a[j] : b[j], for j < count.  a or b may
+      alias out.
+  */
+  template<class T, std::size_t = sizeof(T)>
+  struct select_word
+  {
+    static void apply(std::uint64_t mask, const T * a, const T * b, T * out, std::size_t count) noexcept
+    {
+      for (std::size_t j = 0; j != count; ++j)
+      {
+        out[j] = (mask >> j) & 1 ? a[j] : b[j];
+      }
+    }
+  };
+
+#if defined(__AVX512F__)
+  template<class T>
+  struct select_word<T, 4>
+  {
+    static void apply(std::uint64_t mask, const T * a, const T * b, T * out, std::size_t count) noexcept
+    {
+      for (std::size_t j = 0; j < count; j += 16)
+      {
+        __mmask16 live = static_cast<__mmask16>(count - j >= 16 ? 0xffff : (1U << (count - j)) - 1);
+        __mmask16 k = static_cast<__mmask16>(mask >> j);
+        __m512i v = _mm512_mask_blend_epi32(k,
+          _mm512_maskz_loadu_epi32(live, b + j), _mm512_maskz_loadu_epi32(live, a + j));
+        _mm512_mask_storeu_epi32(out + j, live, v);
+      }
+    }
+  };
+
+  template<class T>
+  struct select_word<T, 8>
+  {
+    static void apply(std::uint64_t mask, const T * a, const T * b, T * out, std::size_t count) noexcept
+    {
+      for (std::size_t j = 0; j < count; j += 8)
+      {
+        __mmask8 live = static_cast<__mmask8>(count - j >= 8 ? 0xff : (1U << (count - j)) - 1);
+        __mmask8 k = static_cast<__mmask8>(mask >> j);
+        __m512i v = _mm512_mask_blend_epi64(k,
+          _mm512_maskz_loadu_epi64(live, b + j), _mm512_maskz_loadu_epi64(live, a + j));
+        _mm512_mask_storeu_epi64(out + j, live, v);
+      }
+    }
+  };
+#elif defined(__AVX2__)
+  template<class T>
+  struct select_word<T, 4>
+  {
+    static void apply(std::uint64_t mask, const T * a, const T * b, T * out, std::size_t count) noexcept
+    {
+      const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+      std::size_t j = 0;
+      for (; j + 8 <= count; j += 8)
+      {
+        __m256i m = _mm256_set1_epi32(static_cast<int>((mask >> j) & 0xff));
+        __m256i lanes = _mm256_cmpeq_epi32(_mm256_and_si256(m, bit), bit);
+        __m256i v = _mm256_blendv_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + j)), lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), v);
+      }
+      if (j != count)
+      {
+        select_word<T, 0>::apply(mask >> j, a + j, b + j, out + j, count - j);
+      }
+    }
+  };
+
+  template<class T>
+  struct select_word<T, 8>
+  {
+    static void apply(std::uint64_t mask, const T * a, const T * b, T * out, std::size_t count) noexcept
+    {
+      const __m256i bit = _mm256_setr_epi64x(1, 2, 4, 8);
+      std::size_t j = 0;
+      for (; j + 4 <= count; j += 4)
+      {
+        __m256i m = _mm256_set1_epi64x(static_cast<long long>((mask >> j) & 0xf));
+        __m256i lanes = _mm256_cmpeq_epi64(_mm256_and_si256(m, bit), bit);
+        __m256i v = _mm256_blendv_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + j)), lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), v);
+      }
+      if (j != count)
+      {
+        select_word<T, 0>::apply(mask >> j, a + j, b + j, out + j, count - j);
+      }
+    }
+  };
+#endif
+
+  //! Fills the slots of out that are empty from c, and or's in c's bits
+  template<class T>
+  void coalesce_into(std::optional_vector<T> & out, const std::optional_vector<T> & c) noexcept
+  {
+    const std::size_t n = out.size();
+    T * values = out.data();
+    std::uint64_t * bits = out.bitmap();
+    const T * cvalues = c.data();
+    const std::uint64_t * cbits = c.bitmap();
+    for (std::size_t w = 0; w != bitmap_words(n); ++w)
+    {
+      std::size_t base = w * bitmap_word_bits;
+      if (~bits[w] & cbits[w])
+      {
+        select_word<T>::apply(bits[w], values + base, cvalues + base, values + base,
+                              std::min(bitmap_word_bits, n - base));
+      }
+      bits[w] |= cbits[w];
+    }
+    if (n)
+    {
+      bits[bitmap_words(n) - 1] &= tail_mask(n);
+    }
+  }
+}
+
+namespace std {
+namespace compute {
+  ///optional_vector columns
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> add( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::add_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> sub( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::sub_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> mul( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::mul_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> div( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::div_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> min( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::min_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> max( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::max_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> eq( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::eq_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> ne( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::ne_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> lt( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::lt_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> le( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::le_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> gt( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::gt_op>(a, b);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<bool> ge( const optional_vector<T> & a, const optional_vector<T> & b )
+  {
+    return detail::binary<detail::ge_op>(a, b);
+  }
+
+  //! The bulk value_or: every value of a, with value where a is empty
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  std::vector<T> fill_null( const optional_vector<T> & a, typename detail::identity<T>::type value )
+  {
+    const std::size_t n = a.size();
+    std::vector<T> out(n);
+    T values[detail::bitmap_word_bits];
+    std::fill(values, values + detail::bitmap_word_bits, value);
+    for (std::size_t w = 0; w != detail::bitmap_words(n); ++w)
+    {
+      std::size_t base = w * detail::bitmap_word_bits;
+      detail::select_word<T>::apply(a.bitmap()[w], a.data() + base, values, out.data() + base,
+                                    std::min(detail::bitmap_word_bits, n - base));
+    }
+    return out;
+  }
+
+  /*! The first engaged value of first, rest... at each position, empty
+      where they all are.
+  */
+  template<class T, class... Rest, When<detail::Arithmetic<T>> = Enable>
+  optional_vector<T> coalesce( const optional_vector<T> & first, const Rest &... rest )
+  {
+    const std::size_t n = first.size();
+    int sizes[] = {0, (detail::require_same_size(n, rest.size()), 0)...};
+    static_cast<void>(sizes);
+    optional_vector<T> out(n);
+    if (n)
+    {
+      std::memcpy(out.data(), first.data(), n * sizeof(T));
+      std::memcpy(out.bitmap(), first.bitmap(), detail::bitmap_words(n) * sizeof(std::uint64_t));
+    }
+    int fold[] = {0, (detail::coalesce_into(out, rest), 0)...};
+    static_cast<void>(fold);
+    return out;
+  }
+
+  ///optional<T> arrays, out may be a or b
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void add( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::add_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void sub( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::sub_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void mul( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::mul_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void div( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::div_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void min( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::min_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void max( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    detail::binary<detail::max_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void eq( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::eq_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void ne( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::ne_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void lt( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::lt_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void le( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::le_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void gt( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::gt_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void ge( const optional<T> * a, const optional<T> * b, std::size_t n, optional<bool> * out )
+  {
+    detail::binary<detail::ge_op>(a, b, n, out);
+  }
+
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void fill_null( const optional<T> * a, std::size_t n, typename detail::identity<T>::type value, T * out )
+  {
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      out[i] = a[i].has_value() ? *a[i] : value;
+    }
+  }
+
+  //! out[i] = a[i] if engaged else b[i]
+  template<class T, When<detail::Arithmetic<T>> = Enable>
+  void coalesce( const optional<T> * a, const optional<T> * b, std::size_t n, optional<T> * out )
+  {
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      out[i] = a[i].has_value() ? a[i] : b[i];
+    }
+  }
+}
+}
@@ -0,0 +1,266 @@
+#pragma once
+#include "optional_kernels.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+/*! Batch hashing of optional keys for hash joins and group-by: one 64 bit
+    hash per row, written to an output array.
+
+    Each engaged value becomes a 64 bit key first: integers widened (so
+    int32 and int64 columns agree), floating point as the bits of the
+    double with -0.0 folded into 0.0, anything else through std::hash.
+    Empty rows take a fixed key instead.  The key is then mixed with
+    murmur3's 64 bit finaliser, 8 rows per AVX-512 register or 4 per AVX2
+    register, selecting the empty key with a blend instead of a branch.
+
+    hash() starts a row hash from one column; hash_combine() folds a
+    further column into hashes already in out, order sensitively, for
+    multi-column keys.  These hashes are not std::hash's, which has to
+    agree with hash<T> for engaged values.
+*/
+namespace detail {
+  constexpr std::uint64_t hash_empty_key = 0x9e3779b97f4a7c15ULL;
+  constexpr std::uint64_t hash_combine_factor = 0x9e3779b97f4a7c15ULL;
+  constexpr std::uint64_t hash_fmix1 = 0xff51afd7ed558ccdULL;
+  constexpr std::uint64_t hash_fmix2 = 0xc4ceb9fe1a85ec53ULL;
+
+  template<class T>
+  Enable_When<std::uint64_t, std::is_integral<T>> hash_key(const T & x) noexcept
+  {
+    return static_cast<std::uint64_t>(x);
+  }
+
+  template<class T>
+  Enable_When<std::uint64_t, std::is_floating_point<T>> hash_key(const T & x) noexcept
+  {
+    double d = static_cast<double>(x) + 0.0;
+    std::uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+  }
+
+  template<class T>
+  Enable_When<std::uint64_t, Not<std::is_arithmetic<T>>> hash_key(const T & x)
+  {
+    return static_cast<std::uint64_t>(std::hash<T>()(x));
+  }
+
+  ///The operations hash_step needs, for a word and each register width
+
+  inline std::uint64_t add64(std::uint64_t a, std::uint64_t b) noexcept { return a + b; }
+  inline std::uint64_t mul64(std::uint64_t a, std::uint64_t c) noexcept { return a * c; }
+  inline std::uint64_t xorshift33(std::uint64_t a) noexcept { return a ^ (a >> 33); }
+
+#if defined(__AVX2__)
+  inline __m256i add64(__m256i a, __m256i b) noexcept { return _mm256_add_epi64(a, b); }
+  inline __m256i xorshift33(__m256i a) noexcept { return _mm256_xor_si256(a, _mm256_srli_epi64(a, 33)); }
+
+  //! Low 64 bits of a * c from 32 bit multiplies, AVX2 has no 64 bit one
+  inline __m256i mul64(__m256i a, std::uint64_t c) noexcept
+  {
+    const __m256i lo = _mm256_set1_epi64x(static_cast<long long>(c & 0xffffffffU));
+    const __m256i hi = _mm256_set1_epi64x(static_cast<long long>(c >> 32));
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), lo),
+                                     _mm256_mul_epu32(a, hi));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, lo), _mm256_slli_epi64(cross, 32));
+  }
+#endif
+
+#if defined(__AVX512F__)
+  inline __m512i add64(__m512i a, __m512i b) noexcept { return _mm512_add_epi64(a, b); }
+  inline __m512i xorshift33(__m512i a) noexcept { return _mm512_xor_si512(a, _mm512_srli_epi64(a, 33)); }
+
+  inline __m512i mul64(__m512i a, std::uint64_t c) noexcept
+  {
+#if defined(__AVX512DQ__)
+    return _mm512_mullo_epi64(a, _mm512_set1_epi64(static_cast<long long>(c)));
+#else
+    const __m512i lo = _mm512_set1_epi64(static_cast<long long>(c & 0xffffffffU));
+    const __m512i hi = _mm512_set1_epi64(static_cast<long long>(c >> 32));
+    __m512i cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), lo),
+                                     _mm512_mul_epu32(a, hi));
+    return _mm512_add_epi64(_mm512_mul_epu32(a, lo), _mm512_slli_epi64(cross, 32));
+#endif
+  }
+#endif
+
+  //! mix(prev * factor + key), mix being murmur3's fmix64
+  template<class W>
+  W hash_step(W prev, W key) noexcept
+  {
+    W x = add64(mul64(prev, hash_combine_factor), key);
+    x = mul64(xorshift33(x), hash_fmix1);
+    x = mul64(xorshift33(x), hash_fmix2);
+    return xorshift33(x);
+  }
+
+  /*! Hashes the 64 keys of one word into out, keys whose mask bit is
+      clear replaced by hash_empty_key.  Combine reads the previous hashes
+      from out, otherwise they are 0.
+  */
+  template<bool Combine>
+  void hash_word(const std::uint64_t * keys, std::uint64_t mask, std::uint64_t * out) noexcept
+  {
+#if defined(__AVX512F__)
+    const __m512i empty = _mm512_set1_epi64(static_cast<long long>(hash_empty_key));
+    for (unsigned r = 0; r != 8; ++r)
+    {
+      __m512i key = _mm512_mask_blend_epi64(static_cast<__mmask8>(mask >> (8 * r)), empty,
+                                            _mm512_loadu_si512(keys + 8 * r));
+      __m512i prev = Combine ? _mm512_loadu_si512(out + 8 * r) : _mm512_setzero_si512();
+      _mm512_storeu_si512(out + 8 * r, hash_step(prev, key));
+    }
+#elif defined(__AVX2__)
+    const __m256i empty = _mm256_set1_epi64x(static_cast<long long>(hash_empty_key));
+    const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    for (unsigned r = 0; r != 16; ++r)
+    {
+      __m256i m = _mm256_set1_epi64x(static_cast<long long>((mask >> (4 * r)) & 0xf));
+      __m256i keep = _mm256_cmpeq_epi64(_mm256_and_si256(m, lane_bits), lane_bits);
+      __m256i key = _mm256_blendv_epi8(empty,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + 4 * r)), keep);
+      __m256i prev = Combine
+        ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(out + 4 * r))
+        : _mm256_setzero_si256();
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 4 * r), hash_step(prev, key));
+    }
+#else
+    for (unsigned i = 0; i != bitmap_word_bits; ++i)
+    {
+      std::uint64_t key = (mask >> i) & 1 ? keys[i] : hash_empty_key;
+      out[i] = hash_step(Combine ? out[i] : std::uint64_t(0), key);
+    }
+#endif
+  }
+
+  /*! Runs hash_word over n rows; keys(w, keys) fills the word's keys
+      below n and returns its mask, bits at or past n clear.
+  */
+  template<bool Combine, class Keys>
+  void hash_rows(std::size_t n, std::uint64_t * out, Keys keys)
+  {
+    for (std::size_t w = 0, words = bitmap_words(n); w != words; ++w)
+    {
+      std::uint64_t word[bitmap_word_bits];
+      std::uint64_t mask = keys(w, word);
+      std::size_t base = w * bitmap_word_bits;
+      if (base + bitmap_word_bits <= n)
+      {
+        hash_word<Combine>(word, mask, out + base);
+      }
+      else
+      {
+        // the last word may stop short of out's end
+        std::fill(word + (n - base), word + bitmap_word_bits, 0);
+        std::uint64_t tail[bitmap_word_bits] = {};
+        if (Combine)
+        {
+          std::copy(out + base, out + n, tail);
+        }
+        hash_word<Combine>(word, mask, tail);
+        std::copy(tail, tail + (n - base), out + base);
+      }
+    }
+  }
+
+  //! Keys of every row, engaged or not: stale arithmetic values are harmless
+  template<class T>
+  void column_keys(const T * values, std::size_t count, std::uint64_t, std::uint64_t * keys, std::true_type) noexcept
+  {
+    for (std::size_t i = 0; i != count; ++i)
+    {
+      keys[i] = hash_key(values[i]);
+    }
+  }
+
+  //! Keys of the engaged rows only, the others hold no object
+  template<class T>
+  void column_keys(const T * values, std::size_t count, std::uint64_t mask, std::uint64_t * keys, std::false_type)
+  {
+    std::fill(keys, keys + count, 0);
+    while (mask)
+    {
+      unsigned i = ctz(mask);
+      keys[i] = hash_key(values[i]);
+      mask &= mask - 1;
+    }
+  }
+
+  template<bool Combine, class T>
+  void hash_column(const T * values, const std::uint64_t * bitmap, std::size_t n, std::uint64_t * out)
+  {
+    hash_rows<Combine>(n, out, [=](std::size_t w, std::uint64_t * keys) {
+      std::size_t base = w * bitmap_word_bits;
+      std::size_t count = std::min(bitmap_word_bits, n - base);
+      std::uint64_t mask = bitmap[w] & (base + bitmap_word_bits <= n ? ~std::uint64_t(0) : tail_mask(n));
+      column_keys(values + base, count, mask, keys, std::is_arithmetic<T>());
+      return mask;
+    });
+  }
+
+  template<bool Combine, class T, bool B>
+  void hash_optionals(const optional<T, B> * a, std::size_t n, std::uint64_t * out)
+  {
+    hash_rows<Combine>(n, out, [=](std::size_t w, std::uint64_t * keys) {
+      std::size_t base = w * bitmap_word_bits;
+      std::size_t count = std::min(bitmap_word_bits, n - base);
+      std::uint64_t mask = 0;
+      for (std::size_t i = 0; i != count; ++i)
+      {
+        bool engaged = a[base + i].has_value();
+        keys[i] = engaged ? hash_key(*a[base + i]) : 0;
+        mask |= std::uint64_t(engaged) << i;
+      }
+      return mask;
+    });
+  }
+}
+
+namespace std {
+namespace compute {
+  ///optional_vector columns, out holding v.size() hashes
+
+  template<class T>
+  void hash( const optional_vector<T> & v, std::uint64_t * out )
+  {
+    detail::hash_column<false>(v.data(), v.bitmap(), v.size(), out);
+  }
+
+  template<class T>
+  void hash_combine( const optional_vector<T> & v, std::uint64_t * out )
+  {
+    detail::hash_column<true>(v.data(), v.bitmap(), v.size(), out);
+  }
+
+  ///A value array and validity bitmap; bits past n are ignored
+
+  template<class T>
+  void hash( const T * values, const std::uint64_t * bitmap, std::size_t n, std::uint64_t * out )
+  {
+    detail::hash_column<false>(values, bitmap, n, out);
+  }
+
+  template<class T>
+  void hash_combine( const T * values, const std::uint64_t * bitmap, std::size_t n, std::uint64_t * out )
+  {
+    detail::hash_column<true>(values, bitmap, n, out);
+  }
+
+  ///optional<T> arrays
+
+  template<class T>
+  void hash( const optional<T> * a, std::size_t n, std::uint64_t * out )
+  {
+    detail::hash_optionals<false>(a, n, out);
+  }
+
+  template<class T>
+  void hash_combine( const optional<T> * a, std::size_t n, std::uint64_t * out )
+  {
+    detail::hash_optionals<true>(a, n, out);
+  }
+}
+}
@@ -0,0 +1,467 @@
+#pragma once
+#include "optional.hpp"
+#include "optional_vector.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/*! Scan kernels over optional values, in two layouts:
+      - a value array plus validity bitmap (optional_vector, or any column
+        using bit i % 64 of word i / 64 for element i), and
+      - a plain range of optional<T>.
+    The bitmap kernels for trivially copyable T of 4 or 8 bytes have
+    AVX-512 (F, VL, BW, VBMI2, plus VPOPCNTDQ when available) and AVX2 +
+    BMI2 paths, picked at compile time from the target flags; everything
+    else runs the portable scalar code.  Bits past n in the bitmap are
+    ignored.  The optional<T> range versions are plain scalar loops:
+    count_engaged is branch free and the compiler may vectorise it, while
+    first_engaged, compact and expand branch on every element.
+*/
+namespace detail {
+  //! Bits of word w that are elements below n
+  constexpr std::uint64_t tail_mask(std::size_t n) noexcept
+  {
+    return n % bitmap_word_bits ? detail::bitmap_mask(n) - 1 : ~std::uint64_t(0);
+  }
+
+  inline unsigned popcount(std::uint64_t w) noexcept
+  {
+    return static_cast<unsigned>(__builtin_popcountll(w));
+  }
+
+  inline unsigned ctz(std::uint64_t w) noexcept
+  {
+    return static_cast<unsigned>(__builtin_ctzll(w));
+  }
+
+  //! Popcount of the words [0, words), AVX2 uses the nibble lookup
+  inline std::size_t count_bits(const std::uint64_t * bitmap, std::size_t words) noexcept
+  {
+    std::size_t count = 0;
+    std::size_t w = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    __m512i sum = _mm512_setzero_si512();
+    for (; w + 8 <= words; w += 8)
+    {
+      sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(_mm512_loadu_si512(bitmap + w)));
+    }
+    count += static_cast<std::size_t>(_mm512_reduce_add_epi64(sum));
+#elif defined(__AVX2__)
+    const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i sum = _mm256_setzero_si256();
+    for (; w + 4 <= words; w += 4)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap + w));
+      __m256i bytes = _mm256_add_epi8(
+        _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low)),
+        _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+      sum = _mm256_add_epi64(sum, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sum);
+    count += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; w != words; ++w)
+    {
+      count += popcount(bitmap[w]);
+    }
+    return count;
+  }
+
+  /*! compact/expand of one 64 element word.  The generic version walks
+      the set bits; the specialisations for 4 and 8 byte values are
+      SIMD.  dense_end bounds how far a full vector load/store may reach
+      in the dense array, past it the scalar walk is used.
+  */
+  template<class T, std::size_t = sizeof(T)>
+  struct word_kernel
+  {
+    static T * compact(const T * values, std::uint64_t w, T * out, const T *) noexcept
+    {
+      while (w)
+      {
+        *out++ = values[ctz(w)];
+        w &= w - 1;
+      }
+      return out;
+    }
+
+    static const T * expand(const T * dense, std::uint64_t w, T * out, const T *) noexcept
+    {
+      while (w)
+      {
+        out[ctz(w)] = *dense++;
+        w &= w - 1;
+      }
+      return dense;
+    }
+  };
+
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+  template<class T>
+  struct word_kernel<T, 4>
+  {
+    static T * compact(const T * values, std::uint64_t w, T * out, const T *) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += 16)
+      {
+        __mmask16 m = static_cast<__mmask16>(w >> i);
+        __m512i v = _mm512_maskz_loadu_epi32(m, values + i);
+        _mm512_mask_compressstoreu_epi32(out, m, v);
+        out += popcount(m);
+      }
+      return out;
+    }
+
+    static const T * expand(const T * dense, std::uint64_t w, T * out, const T *) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += 16)
+      {
+        __mmask16 m = static_cast<__mmask16>(w >> i);
+        __m512i v = _mm512_maskz_expandloadu_epi32(m, dense);
+        _mm512_mask_storeu_epi32(out + i, m, v);
+        dense += popcount(m);
+      }
+      return dense;
+    }
+  };
+
+  template<class T>
+  struct word_kernel<T, 8>
+  {
+    static T * compact(const T * values, std::uint64_t w, T * out, const T *) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += 8)
+      {
+        __mmask8 m = static_cast<__mmask8>(w >> i);
+        __m512i v = _mm512_maskz_loadu_epi64(m, values + i);
+        _mm512_mask_compressstoreu_epi64(out, m, v);
+        out += popcount(m);
+      }
+      return out;
+    }
+
+    static const T * expand(const T * dense, std::uint64_t w, T * out, const T *) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += 8)
+      {
+        __mmask8 m = static_cast<__mmask8>(w >> i);
+        __m512i v = _mm512_maskz_expandloadu_epi64(m, dense);
+        _mm512_mask_storeu_epi64(out + i, m, v);
+        dense += popcount(m);
+      }
+      return dense;
+    }
+  };
+#elif defined(__AVX2__) && defined(__BMI2__)
+  /*! AVX2 has no compress/expand, the lane permutation for an 8 lane
+      mask is built with pext/pdep: spread each mask bit over a byte,
+      then gather (compact) or scatter (expand) the byte indices 0..7.
+  */
+  inline __m256i compact_permutation(unsigned mask8) noexcept
+  {
+    std::uint64_t spread = _pdep_u64(mask8, 0x0101010101010101ULL) * 0xff;
+    std::uint64_t wanted = _pext_u64(0x0706050403020100ULL, spread);
+    return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(wanted)));
+  }
+
+  inline __m256i expand_permutation(unsigned mask8) noexcept
+  {
+    std::uint64_t spread = _pdep_u64(mask8, 0x0101010101010101ULL) * 0xff;
+    std::uint64_t wanted = _pdep_u64(0x0706050403020100ULL, spread);
+    return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(wanted)));
+  }
+
+  //! Lane mask for _mm256_maskstore_epi32 from 8 mask bits
+  inline __m256i lane_mask(unsigned mask8) noexcept
+  {
+    const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i m = _mm256_set1_epi32(static_cast<int>(mask8));
+    return _mm256_cmpeq_epi32(_mm256_and_si256(m, bit), bit);
+  }
+
+  //! 8 bit mask over 4 lanes of 64 bits as a mask over 8 lanes of 32
+  inline unsigned widen_mask(unsigned mask4) noexcept
+  {
+    return static_cast<unsigned>(_pdep_u32(mask4, 0x55) * 3);
+  }
+
+  template<class T, unsigned Lanes>
+  struct avx2_word_kernel
+  {
+    static unsigned lanes_mask(std::uint64_t w, unsigned i) noexcept
+    {
+      unsigned m = static_cast<unsigned>(w >> i) & ((1U << Lanes) - 1);
+      return Lanes == 8 ? m : widen_mask(m);
+    }
+
+    static T * compact(const T * values, std::uint64_t w, T * out, const T * dense_end) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += Lanes)
+      {
+        unsigned m = static_cast<unsigned>(w >> i) & ((1U << Lanes) - 1);
+        if (!m)
+        {
+          continue;
+        }
+        if (out + Lanes > dense_end)
+        {
+          out = word_kernel<T, 0>::compact(values + i, m, out, dense_end);
+          continue;
+        }
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        v = _mm256_permutevar8x32_epi32(v, compact_permutation(lanes_mask(w, i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v);
+        out += popcount(m);
+      }
+      return out;
+    }
+
+    static const T * expand(const T * dense, std::uint64_t w, T * out, const T * dense_end) noexcept
+    {
+      for (unsigned i = 0; i != 64; i += Lanes)
+      {
+        unsigned m = static_cast<unsigned>(w >> i) & ((1U << Lanes) - 1);
+        if (!m)
+        {
+          continue;
+        }
+        if (dense + Lanes > dense_end)
+        {
+          dense = word_kernel<T, 0>::expand(dense, m, out + i, dense_end);
+          continue;
+        }
+        unsigned lanes = lanes_mask(w, i);
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dense));
+        v = _mm256_permutevar8x32_epi32(v, expand_permutation(lanes));
+        _mm256_maskstore_epi32(reinterpret_cast<int *>(out + i), lane_mask(lanes), v);
+        dense += popcount(m);
+      }
+      return dense;
+    }
+  };
+
+  template<class T>
+  struct word_kernel<T, 4> : avx2_word_kernel<T, 8> {};
+
+  template<class T>
+  struct word_kernel<T, 8> : avx2_word_kernel<T, 4> {};
+#endif
+
+  //! Index of the first set bit in [0, n), or n
+  inline std::size_t first_bit(const std::uint64_t * bitmap, std::size_t n) noexcept
+  {
+    std::size_t words = bitmap_words(n);
+    std::size_t w = 0;
+#if defined(__AVX512F__)
+    for (; w + 8 <= words; w += 8)
+    {
+      __m512i v = _mm512_loadu_si512(bitmap + w);
+      if (_mm512_test_epi64_mask(v, v))
+      {
+        break;
+      }
+    }
+#elif defined(__AVX2__)
+    for (; w + 4 <= words; w += 4)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap + w));
+      if (!_mm256_testz_si256(v, v))
+      {
+        break;
+      }
+    }
+#endif
+    for (; w != words; ++w)
+    {
+      std::uint64_t bits = bitmap[w];
+      if (w + 1 == words)
+      {
+        bits &= tail_mask(n);
+      }
+      if (bits)
+      {
+        return w * bitmap_word_bits + ctz(bits);
+      }
+    }
+    return n;
+  }
+}
+
+namespace std {
+  ///Bitmap layout
+
+  //! Number of set bits among the first n
+  inline std::size_t count_engaged( const std::uint64_t * bitmap, std::size_t n ) noexcept
+  {
+    std::size_t full = n / detail::bitmap_word_bits;
+    std::size_t count = detail::count_bits(bitmap, full);
+    if (n % detail::bitmap_word_bits)
+    {
+      count += detail::popcount(bitmap[full] & detail::tail_mask(n));
+    }
+    return count;
+  }
+
+  //! Index of the first engaged element, or n if there is none
+  inline std::size_t first_engaged( const std::uint64_t * bitmap, std::size_t n ) noexcept
+  {
+    return detail::first_bit(bitmap, n);
+  }
+
+  /*! Copies the engaged values among the first n to out, in order, and
+      returns the end of what was written.  out needs room for
+      count_engaged(bitmap, n) values and must not overlap values.
+  */
+  template<class T,
+    When<
+      std::is_trivially_copyable<T>
+    > = Enable
+  >
+  T * compact( const T * values, const std::uint64_t * bitmap, std::size_t n, T * out ) noexcept
+  {
+    const T * out_end = out + count_engaged(bitmap, n);
+    std::size_t words = detail::bitmap_words(n);
+    for (std::size_t w = 0; w != words; ++w)
+    {
+      std::uint64_t bits = bitmap[w];
+      if (w + 1 == words)
+      {
+        bits &= detail::tail_mask(n);
+      }
+      if (bits == ~std::uint64_t(0))
+      {
+        std::memcpy(out, values + w * detail::bitmap_word_bits, sizeof(T) * detail::bitmap_word_bits);
+        out += detail::bitmap_word_bits;
+      }
+      else if (bits)
+      {
+        out = detail::word_kernel<T>::compact(values + w * detail::bitmap_word_bits, bits, out, out_end);
+      }
+    }
+    return out;
+  }
+
+  /*! The inverse of compact: writes consecutive values from dense to the
+      engaged positions among the first n of out, leaving the others
+      untouched, and returns the end of what was read from dense.
+  */
+  template<class T,
+    When<
+      std::is_trivially_copyable<T>
+    > = Enable
+  >
+  const T * expand( const T * dense, const std::uint64_t * bitmap, std::size_t n, T * out ) noexcept
+  {
+    const T * dense_end = dense + count_engaged(bitmap, n);
+    std::size_t words = detail::bitmap_words(n);
+    for (std::size_t w = 0; w != words; ++w)
+    {
+      std::uint64_t bits = bitmap[w];
+      if (w + 1 == words)
+      {
+        bits &= detail::tail_mask(n);
+      }
+      if (bits == ~std::uint64_t(0))
+      {
+        std::memcpy(out + w * detail::bitmap_word_bits, dense, sizeof(T) * detail::bitmap_word_bits);
+        dense += detail::bitmap_word_bits;
+      }
+      else if (bits)
+      {
+        dense = detail::word_kernel<T>::expand(dense, bits, out + w * detail::bitmap_word_bits, dense_end);
+      }
+    }
+    return dense;
+  }
+
+  template<class T>
+  std::size_t count_engaged( const optional_vector<T> & v ) noexcept
+  {
+    return count_engaged(v.bitmap(), v.size());
+  }
+
+  template<class T>
+  std::size_t first_engaged( const optional_vector<T> & v ) noexcept
+  {
+    return first_engaged(v.bitmap(), v.size());
+  }
+
+  template<class T>
+  T * compact( const optional_vector<T> & v, T * out ) noexcept
+  {
+    return compact(v.data(), v.bitmap(), v.size(), out);
+  }
+
+  ///optional<T> ranges
+
+  template<class T, bool B>
+  std::size_t count_engaged( const detail::optional<T, B> * first,
+                             const detail::optional<T, B> * last ) noexcept
+  {
+    std::size_t count = 0;
+    for (; first != last; ++first)
+    {
+      count += first->has_value();
+    }
+    return count;
+  }
+
+  template<class T, bool B>
+  const detail::optional<T, B> * first_engaged( const detail::optional<T, B> * first,
+                                                const detail::optional<T, B> * last ) noexcept
+  {
+    for (; first != last; ++first)
+    {
+      if (first->has_value())
+      {
+        break;
+      }
+    }
+    return first;
+  }
+
+  //! Copies the engaged values of [first, last) to out, in order
+  template<class T, bool B, class OutputIt>
+  OutputIt compact( const detail::optional<T, B> * first,
+                    const detail::optional<T, B> * last, OutputIt out )
+  {
+    for (; first != last; ++first)
+    {
+      if (first->has_value())
+      {
+        *out++ = **first;
+      }
+    }
+    return out;
+  }
+
+  /*! For every engaged element of [first, last) engages the matching
+      element of out with the next value from dense, and resets the rest.
+      Returns the end of what was read from dense.
+  */
+  template<class T, bool B, class U, class InputIt>
+  InputIt expand( InputIt dense, const detail::optional<T, B> * first,
+                  const detail::optional<T, B> * last, optional<U> * out )
+  {
+    for (; first != last; ++first, ++out)
+    {
+      if (first->has_value())
+      {
+        *out = *dense++;
+      }
+      else
+      {
+        out->reset();
+      }
+    }
+    return dense;
+  }
+}
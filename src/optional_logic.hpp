@@ -0,0 +1,386 @@
+#pragma once
+#include "optional_kernels.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace detail {
+  struct bool_vector_access;
+}
+
+namespace std {
+  /*! A packed column of optional<bool>: two bits per element, one in a
+      validity bitmap and one in a value bitmap.  A value bit is only set
+      where the validity bit is, so a null is always (0, 0), and bits past
+      size() are clear in both.
+  */
+  class optional_bool_vector
+  {
+    public:
+    using value_type = std::optional<bool>;
+    using size_type = std::size_t;
+
+    ///Constructor
+    optional_bool_vector() = default;
+
+    //! n empty elements
+    explicit optional_bool_vector( size_type n )
+    {
+      resize(n);
+    }
+
+    optional_bool_vector( std::initializer_list<std::optional<bool>> ilist )
+      : optional_bool_vector(ilist.begin(), ilist.end())
+    {
+    }
+
+    optional_bool_vector( const std::optional<bool> * first, const std::optional<bool> * last )
+    {
+      resize(static_cast<size_type>(last - first));
+      for (size_type i = 0; i != size_; ++i)
+      {
+        set(i, first[i]);
+      }
+    }
+
+    //! Packs a column of one byte bools, such as compute::eq returns
+    explicit optional_bool_vector( const optional_vector<bool> & v )
+    {
+      resize(v.size());
+      std::copy(v.bitmap(), v.bitmap() + valid_.size(), valid_.begin());
+      const bool * x = v.data();
+      for (size_type w = 0; w != values_.size(); ++w)
+      {
+        size_type base = w * detail::bitmap_word_bits;
+        size_type count = std::min(detail::bitmap_word_bits, size_ - base);
+        std::uint64_t bits = 0;
+        for (size_type j = 0; j != count; ++j)
+        {
+          bits |= std::uint64_t(x[base + j]) << j;
+        }
+        values_[w] = bits & valid_[w];
+      }
+    }
+
+    ///Capacity
+    size_type size() const noexcept
+    {
+      return size_;
+    }
+
+    bool empty() const noexcept
+    {
+      return size_ == 0;
+    }
+
+    ///Element access
+    bool has_value( size_type i ) const noexcept
+    {
+      return (valid_[i / detail::bitmap_word_bits] & detail::bitmap_mask(i)) != 0;
+    }
+
+    std::optional<bool> operator[]( size_type i ) const noexcept
+    {
+      return has_value(i) ? std::optional<bool>(value_bit(i)) : std::optional<bool>();
+    }
+
+    bool value( size_type i ) const
+    {
+      if (!has_value(i))
+      {
+        detail::throw_bad_optional_access();
+      }
+      return value_bit(i);
+    }
+
+    //! The validity bitmap, bitmap_words(size()) words
+    const std::uint64_t * bitmap() const noexcept
+    {
+      return valid_.data();
+    }
+
+    //! The value bitmap, clear wherever bitmap() is
+    const std::uint64_t * values() const noexcept
+    {
+      return values_.data();
+    }
+
+    ///Modifiers
+    void push_back( const std::optional<bool> & o )
+    {
+      resize(size_ + 1);
+      set(size_ - 1, o);
+    }
+
+    void set( size_type i, const std::optional<bool> & o ) noexcept
+    {
+      std::uint64_t & valid = valid_[i / detail::bitmap_word_bits];
+      std::uint64_t & value = values_[i / detail::bitmap_word_bits];
+      std::uint64_t mask = detail::bitmap_mask(i);
+      valid = o.has_value() ? valid | mask : valid & ~mask;
+      value = o.has_value() && *o ? value | mask : value & ~mask;
+    }
+
+    void reset( size_type i ) noexcept
+    {
+      set(i, std::nullopt);
+    }
+
+    //! Grows with empty elements or drops the tail
+    void resize( size_type n )
+    {
+      valid_.resize(detail::bitmap_words(n));
+      values_.resize(detail::bitmap_words(n));
+      if (n < size_ && n % detail::bitmap_word_bits)
+      {
+        valid_.back() &= detail::tail_mask(n);
+        values_.back() &= detail::tail_mask(n);
+      }
+      size_ = n;
+    }
+
+    void clear() noexcept
+    {
+      valid_.clear();
+      values_.clear();
+      size_ = 0;
+    }
+
+    void swap( optional_bool_vector & other ) noexcept
+    {
+      using std::swap;
+      swap(valid_, other.valid_);
+      swap(values_, other.values_);
+      swap(size_, other.size_);
+    }
+
+    private:
+    //! Only the compute code writes the bitmaps in bulk, and keeps the
+    //! invariant while it does
+    friend struct detail::bool_vector_access;
+
+    bool value_bit( size_type i ) const noexcept
+    {
+      return (values_[i / detail::bitmap_word_bits] & detail::bitmap_mask(i)) != 0;
+    }
+
+    std::vector<std::uint64_t> valid_;
+    std::vector<std::uint64_t> values_;
+    size_type size_ = 0;
+  };
+
+  inline void swap( optional_bool_vector & a, optional_bool_vector & b ) noexcept
+  {
+    a.swap(b);
+  }
+}
+
+namespace detail {
+  struct bool_vector_access
+  {
+    static std::uint64_t * bitmap(std::optional_bool_vector & v) noexcept
+    {
+      return v.valid_.data();
+    }
+
+    static std::uint64_t * values(std::optional_bool_vector & v) noexcept
+    {
+      return v.values_.data();
+    }
+  };
+}
+
+/*! Kleene logic a word at a time, written once over the bitwise
+    operations of a 64 bit word, an AVX2 register (256 rows) and an
+    AVX-512 register (512 rows).  Inputs keep the column invariant, value
+    bits only where valid, and so do the results.
+*/
+namespace detail {
+  inline std::uint64_t bit_and(std::uint64_t a, std::uint64_t b) noexcept { return a & b; }
+  inline std::uint64_t bit_or(std::uint64_t a, std::uint64_t b) noexcept { return a | b; }
+  //! ~a & b, the operand order of the andnot instructions
+  inline std::uint64_t bit_andnot(std::uint64_t a, std::uint64_t b) noexcept { return ~a & b; }
+
+#if defined(__AVX2__)
+  inline __m256i bit_and(__m256i a, __m256i b) noexcept { return _mm256_and_si256(a, b); }
+  inline __m256i bit_or(__m256i a, __m256i b) noexcept { return _mm256_or_si256(a, b); }
+  inline __m256i bit_andnot(__m256i a, __m256i b) noexcept { return _mm256_andnot_si256(a, b); }
+#endif
+
+#if defined(__AVX512F__)
+  inline __m512i bit_and(__m512i a, __m512i b) noexcept { return _mm512_and_si512(a, b); }
+  inline __m512i bit_or(__m512i a, __m512i b) noexcept { return _mm512_or_si512(a, b); }
+  // vpternlogq truth table for ~a & b; GCC 12's _mm512_andnot_si512 trips
+  // -Wmaybe-uninitialized inside its own header
+  inline __m512i bit_andnot(__m512i a, __m512i b) noexcept { return _mm512_ternarylogic_epi64(a, b, b, 0x0c); }
+#endif
+
+  //! false and anything is false, otherwise null if either is
+  struct kleene_and
+  {
+    template<class W>
+    void operator()(W va, W xa, W vb, W xb, W & v, W & x) const noexcept
+    {
+      x = bit_and(xa, xb);
+      v = bit_or(bit_and(va, vb), bit_or(bit_andnot(xa, va), bit_andnot(xb, vb)));
+    }
+  };
+
+  //! true or anything is true, otherwise null if either is
+  struct kleene_or
+  {
+    template<class W>
+    void operator()(W va, W xa, W vb, W xb, W & v, W & x) const noexcept
+    {
+      x = bit_or(xa, xb);
+      v = bit_or(bit_and(va, vb), x);
+    }
+  };
+
+  //! Applies Op to the words [0, words) of two columns
+  template<class Op>
+  void logic_words(const std::uint64_t * va, const std::uint64_t * xa,
+                   const std::uint64_t * vb, const std::uint64_t * xb,
+                   std::uint64_t * v, std::uint64_t * x, std::size_t words) noexcept
+  {
+    Op op;
+    std::size_t w = 0;
+#if defined(__AVX512F__)
+    for (; w + 8 <= words; w += 8)
+    {
+      __m512i rv, rx;
+      op(_mm512_loadu_si512(va + w), _mm512_loadu_si512(xa + w),
+         _mm512_loadu_si512(vb + w), _mm512_loadu_si512(xb + w), rv, rx);
+      _mm512_storeu_si512(v + w, rv);
+      _mm512_storeu_si512(x + w, rx);
+    }
+#elif defined(__AVX2__)
+    auto load = [](const std::uint64_t * p) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    };
+    for (; w + 4 <= words; w += 4)
+    {
+      __m256i rv, rx;
+      op(load(va + w), load(xa + w), load(vb + w), load(xb + w), rv, rx);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(v + w), rv);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(x + w), rx);
+    }
+#endif
+    for (; w != words; ++w)
+    {
+      op(va[w], xa[w], vb[w], xb[w], v[w], x[w]);
+    }
+  }
+
+  template<class Op>
+  std::optional_bool_vector logic(const std::optional_bool_vector & a, const std::optional_bool_vector & b)
+  {
+    require_same_size(a.size(), b.size());
+    std::optional_bool_vector out(a.size());
+    logic_words<Op>(a.bitmap(), a.values(), b.bitmap(), b.values(),
+                    bool_vector_access::bitmap(out), bool_vector_access::values(out),
+                    bitmap_words(a.size()));
+    return out;
+  }
+
+  //! A column with every element valid and the value bits of select
+  template<class Select>
+  std::optional_bool_vector test(const std::optional_bool_vector & a, Select select)
+  {
+    const std::size_t n = a.size();
+    const std::size_t words = bitmap_words(n);
+    std::optional_bool_vector out(n);
+    const std::uint64_t * v = a.bitmap();
+    const std::uint64_t * x = a.values();
+    std::uint64_t * ov = bool_vector_access::bitmap(out);
+    std::uint64_t * ox = bool_vector_access::values(out);
+    for (std::size_t w = 0; w != words; ++w)
+    {
+      ov[w] = ~std::uint64_t(0);
+      ox[w] = select(v[w], x[w]);
+    }
+    if (words)
+    {
+      ov[words - 1] &= tail_mask(n);
+      ox[words - 1] &= tail_mask(n);
+    }
+    return out;
+  }
+}
+
+namespace std {
+namespace compute {
+  ///Kleene logic, a and b the same size or std::length_error is thrown
+
+  inline optional_bool_vector logical_and( const optional_bool_vector & a, const optional_bool_vector & b )
+  {
+    return detail::logic<detail::kleene_and>(a, b);
+  }
+
+  inline optional_bool_vector logical_or( const optional_bool_vector & a, const optional_bool_vector & b )
+  {
+    return detail::logic<detail::kleene_or>(a, b);
+  }
+
+  //! null stays null
+  inline optional_bool_vector logical_not( const optional_bool_vector & a )
+  {
+    optional_bool_vector out(a);
+    std::uint64_t * v = detail::bool_vector_access::bitmap(out);
+    std::uint64_t * x = detail::bool_vector_access::values(out);
+    for (std::size_t w = 0, words = detail::bitmap_words(a.size()); w != words; ++w)
+    {
+      x[w] = v[w] & ~x[w];
+    }
+    return out;
+  }
+
+  ///SQL's IS TRUE, IS FALSE and IS NULL, never null themselves
+
+  inline optional_bool_vector is_true( const optional_bool_vector & a )
+  {
+    return detail::test(a, [](std::uint64_t, std::uint64_t x) { return x; });
+  }
+
+  inline optional_bool_vector is_false( const optional_bool_vector & a )
+  {
+    return detail::test(a, [](std::uint64_t v, std::uint64_t x) { return v & ~x; });
+  }
+
+  inline optional_bool_vector is_null( const optional_bool_vector & a )
+  {
+    return detail::test(a, [](std::uint64_t v, std::uint64_t) { return ~v; });
+  }
+
+  ///Reductions
+
+  inline std::size_t count_true( const optional_bool_vector & a ) noexcept
+  {
+    return detail::count_bits(a.values(), detail::bitmap_words(a.size()));
+  }
+
+  inline std::size_t count_null( const optional_bool_vector & a ) noexcept
+  {
+    return a.size() - detail::count_bits(a.bitmap(), detail::bitmap_words(a.size()));
+  }
+
+  inline std::size_t count_false( const optional_bool_vector & a ) noexcept
+  {
+    return a.size() - count_null(a) - count_true(a);
+  }
+
+  //! Kleene OR of every element: true if any is, else null if any is
+  inline optional<bool> any( const optional_bool_vector & a ) noexcept
+  {
+    return count_true(a) ? optional<bool>(true) : count_null(a) ? optional<bool>() : optional<bool>(false);
+  }
+
+  //! Kleene AND of every element: false if any is, else null if any is
+  inline optional<bool> all( const optional_bool_vector & a ) noexcept
+  {
+    return count_false(a) ? optional<bool>(false) : count_null(a) ? optional<bool>() : optional<bool>(true);
+  }
+}
+}
@@ -0,0 +1,529 @@
+#pragma once
+#include "optional.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace detail {
+  //! One validity bit per element, 64 elements to a word
+  constexpr std::size_t bitmap_word_bits = 64;
+
+  constexpr std::size_t bitmap_words(std::size_t n) noexcept
+  {
+    return (n + bitmap_word_bits - 1) / bitmap_word_bits;
+  }
+
+  constexpr std::uint64_t bitmap_mask(std::size_t i) noexcept
+  {
+    return std::uint64_t(1) << (i % bitmap_word_bits);
+  }
+
+  [[noreturn]] OPTIONAL_COLD inline void throw_size_mismatch()
+  {
+#if OPTIONAL_NO_EXCEPTIONS
+    std::abort();
+#else
+    throw std::length_error("optional columns differ in size");
+#endif
+  }
+
+  //! Columns combined element-wise must be the same size
+  inline void require_same_size(std::size_t a, std::size_t b)
+  {
+    if (OPTIONAL_UNLIKELY(a != b))
+    {
+      throw_size_mismatch();
+    }
+  }
+}
+
+namespace std {
+  /*! A column of optional<T> stored as struct-of-arrays: the values sit in
+      a dense array of storage<T> slots and engagement lives in a separate
+      bitmap, one bit per element.  There is no per-element flag or
+      padding, and the value array can be scanned with SIMD.
+
+      Element access returns optional<T&> proxies.  Slots whose bit is
+      clear hold no object; for trivially copyable T they are zero filled
+      when the buffer grows so whole-array scans read defined bytes.
+      Bits past size() are always clear.
+  */
+  template<class T>
+  class optional_vector
+  {
+    using slot = detail::storage<T>;
+
+    template<bool Const>
+    class iterator_
+    {
+      using vector = typename std::conditional<Const, const optional_vector, optional_vector>::type;
+
+      public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = std::optional<T>;
+      using difference_type = std::ptrdiff_t;
+      using reference = std::optional<typename std::conditional<Const, const T&, T&>::type>;
+      using pointer = void;
+
+      iterator_() noexcept = default;
+
+      iterator_( vector * v, std::size_t i ) noexcept
+        : v_(v)
+        , i_(i)
+      {
+      }
+
+      //! iterator converts to const_iterator
+      template<bool C = Const, When<std::integral_constant<bool, C>> = Enable>
+      iterator_( const iterator_<false> & other ) noexcept
+        : v_(other.v_)
+        , i_(other.i_)
+      {
+      }
+
+      reference operator*() const
+      {
+        return (*v_)[i_];
+      }
+
+      iterator_ & operator++() noexcept
+      {
+        ++i_;
+        return *this;
+      }
+
+      iterator_ operator++(int) noexcept
+      {
+        iterator_ tmp(*this);
+        ++i_;
+        return tmp;
+      }
+
+      friend bool operator==( const iterator_ & lhs, const iterator_ & rhs ) noexcept
+      {
+        return lhs.i_ == rhs.i_;
+      }
+
+      friend bool operator!=( const iterator_ & lhs, const iterator_ & rhs ) noexcept
+      {
+        return lhs.i_ != rhs.i_;
+      }
+
+      private:
+      friend class iterator_<true>;
+
+      vector * v_ = nullptr;
+      std::size_t i_ = 0;
+    };
+
+    public:
+    using value_type = std::optional<T>;
+    using size_type = std::size_t;
+    using reference = std::optional<T&>;
+    using const_reference = std::optional<const T&>;
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    ///Constructor
+    optional_vector() = default;
+
+    //! n empty elements
+    explicit optional_vector( size_type n )
+    {
+      resize(n);
+    }
+
+    optional_vector( std::initializer_list<std::optional<T>> ilist )
+    {
+      reserve(ilist.size());
+      for (auto const & o : ilist)
+      {
+        push_back(o);
+      }
+    }
+
+    optional_vector( const optional_vector & other )
+    {
+      reserve(other.size());
+      for (size_type i = 0; i != other.size(); ++i)
+      {
+        push_back(other[i]);
+      }
+    }
+
+    optional_vector( optional_vector && other ) noexcept
+      : values_(other.values_)
+      , bits_(std::move(other.bits_))
+      , size_(other.size_)
+      , capacity_(other.capacity_)
+    {
+      other.values_ = nullptr;
+      other.bits_.clear();
+      other.size_ = other.capacity_ = 0;
+    }
+
+    ~optional_vector()
+    {
+      clear();
+      deallocate(values_, capacity_);
+    }
+
+    ///Assignment
+    optional_vector & operator=( const optional_vector & other )
+    {
+      if (this != &other)
+      {
+        optional_vector tmp(other);
+        swap(tmp);
+      }
+      return *this;
+    }
+
+    optional_vector & operator=( optional_vector && other ) noexcept
+    {
+      optional_vector tmp(std::move(other));
+      swap(tmp);
+      return *this;
+    }
+
+    ///Capacity
+    size_type size() const noexcept
+    {
+      return size_;
+    }
+
+    bool empty() const noexcept
+    {
+      return size_ == 0;
+    }
+
+    size_type capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    void reserve( size_type n )
+    {
+      if (n > capacity_)
+      {
+        reallocate(n);
+      }
+    }
+
+    ///Element access
+    bool has_value( size_type i ) const noexcept
+    {
+      return (bits_[i / detail::bitmap_word_bits] & detail::bitmap_mask(i)) != 0;
+    }
+
+    reference operator[]( size_type i ) noexcept
+    {
+      return has_value(i) ? reference(values_[i].t_) : reference();
+    }
+
+    const_reference operator[]( size_type i ) const noexcept
+    {
+      return has_value(i) ? const_reference(values_[i].t_) : const_reference();
+    }
+
+    //! The value at i, throws bad_optional_access if it is empty
+    T & value( size_type i )
+    {
+      return (*this)[i].value();
+    }
+
+    const T & value( size_type i ) const
+    {
+      return (*this)[i].value();
+    }
+
+    /*! The dense value array, element i is only an object while
+        has_value(i).  storage<T> is a union starting with T and no larger
+        than it, so the slots are laid out exactly like a T array.
+    */
+    const T * data() const noexcept
+    {
+      return reinterpret_cast<const T *>(values_);
+    }
+
+    //! The validity bitmap, bit i % 64 of word i / 64 is element i
+    const std::uint64_t * bitmap() const noexcept
+    {
+      return bits_.data();
+    }
+
+    /*! Mutable raw arrays for kernels that fill a column in bulk.  Only
+        for trivially copyable T, where writing a slot's bytes makes it
+        hold that value; bits past size() must be left clear.
+    */
+    template<class U = T,
+      When<
+        std::is_trivially_copyable<U>
+      > = Enable
+    >
+    T * data() noexcept
+    {
+      return reinterpret_cast<T *>(values_);
+    }
+
+    template<class U = T,
+      When<
+        std::is_trivially_copyable<U>
+      > = Enable
+    >
+    std::uint64_t * bitmap() noexcept
+    {
+      return bits_.data();
+    }
+
+    ///Iterators
+    iterator begin() noexcept { return iterator(this, 0); }
+    iterator end() noexcept { return iterator(this, size_); }
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator end() const noexcept { return const_iterator(this, size_); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    ///Modifiers
+    void push_back( std::nullopt_t )
+    {
+      if (size_ == capacity_)
+      {
+        reallocate(std::max<size_type>(2 * capacity_, 8));
+      }
+      ++size_;
+    }
+
+    template<class U,
+      When<
+        std::is_constructible<T, const U&>
+      > = Enable
+    >
+    void push_back( const std::optional<U> & o )
+    {
+      if (o.has_value())
+      {
+        emplace_back(*o);
+      }
+      else
+      {
+        push_back(std::nullopt);
+      }
+    }
+
+    template<class U,
+      When<
+        std::is_constructible<T, U&&>
+      > = Enable
+    >
+    void push_back( std::optional<U> && o )
+    {
+      if (o.has_value())
+      {
+        emplace_back(std::move(*o));
+      }
+      else
+      {
+        push_back(std::nullopt);
+      }
+    }
+
+    void push_back( const T & value )
+    {
+      emplace_back(value);
+    }
+
+    void push_back( T && value )
+    {
+      emplace_back(std::move(value));
+    }
+
+    template<class... Args>
+    T & emplace_back( Args&&... args )
+    {
+      if (size_ == capacity_)
+      {
+        // args may refer into this vector, build the value before growing
+        T value(std::forward<Args>(args)...);
+        reallocate(std::max<size_type>(2 * capacity_, 8));
+        detail::construct_at(std::addressof(values_[size_].t_), std::move(value));
+      }
+      else
+      {
+        detail::construct_at(std::addressof(values_[size_].t_), std::forward<Args>(args)...);
+      }
+      set(size_);
+      return values_[size_++].t_;
+    }
+
+    void pop_back() noexcept
+    {
+      reset(size_ - 1);
+      --size_;
+    }
+
+    //! Destroys any value at i and constructs a new one in its slot
+    template<class... Args>
+    T & emplace( size_type i, Args&&... args )
+    {
+      reset(i);
+      detail::construct_at(std::addressof(values_[i].t_), std::forward<Args>(args)...);
+      set(i);
+      return values_[i].t_;
+    }
+
+    void reset( size_type i ) noexcept
+    {
+      if (has_value(i))
+      {
+        detail::destruct(values_[i].t_);
+        bits_[i / detail::bitmap_word_bits] &= ~detail::bitmap_mask(i);
+      }
+    }
+
+    //! Grows with empty elements or destroys the tail
+    void resize( size_type n )
+    {
+      if (n < size_)
+      {
+        truncate(n);
+        return;
+      }
+      if (n > capacity_)
+      {
+        reallocate(std::max(n, 2 * capacity_));
+      }
+      size_ = n;
+    }
+
+    void clear() noexcept
+    {
+      truncate(0);
+    }
+
+    void swap( optional_vector & other ) noexcept
+    {
+      using std::swap;
+      swap(values_, other.values_);
+      swap(bits_, other.bits_);
+      swap(size_, other.size_);
+      swap(capacity_, other.capacity_);
+    }
+
+    private:
+    void set( size_type i ) noexcept
+    {
+      bits_[i / detail::bitmap_word_bits] |= detail::bitmap_mask(i);
+    }
+
+    void truncate( size_type n ) noexcept
+    {
+      if (!std::is_trivially_destructible<T>::value)
+      {
+        for (size_type i = n; i != size_; ++i)
+        {
+          reset(i);
+        }
+      }
+      for (size_type w = detail::bitmap_words(n); w < bits_.size(); ++w)
+      {
+        bits_[w] = 0;
+      }
+      if (n % detail::bitmap_word_bits)
+      {
+        bits_[n / detail::bitmap_word_bits] &= detail::bitmap_mask(n) - 1;
+      }
+      size_ = n;
+    }
+
+    static slot * allocate( size_type n )
+    {
+      return std::allocator<slot>().allocate(n);
+    }
+
+    static void deallocate( slot * p, size_type n ) noexcept
+    {
+      if (p)
+      {
+        std::allocator<slot>().deallocate(p, n);
+      }
+    }
+
+    //! bits_ grows first: if that throws nothing has moved yet, and if
+    //! relocating throws the extra zero words are harmless
+    void reallocate( size_type n )
+    {
+      bits_.resize(detail::bitmap_words(n));
+      slot * values = allocate(n);
+      relocate(values, n, std::is_trivially_copyable<T>());
+      deallocate(values_, capacity_);
+      values_ = values;
+      capacity_ = n;
+    }
+
+    //! Trivially copyable T: one memcpy, and zero the new slots
+    void relocate( slot * values, size_type n, std::true_type ) noexcept
+    {
+      if (size_)
+      {
+        std::memcpy(static_cast<void*>(values), values_, size_ * sizeof(slot));
+      }
+      std::memset(static_cast<void*>(values + size_), 0, (n - size_) * sizeof(slot));
+    }
+
+    void relocate( slot * values, size_type n, std::false_type )
+    {
+      size_type i = 0;
+#if !OPTIONAL_NO_EXCEPTIONS
+      try
+      {
+#endif
+        for (; i != size_; ++i)
+        {
+          if (has_value(i))
+          {
+            detail::construct_at(std::addressof(values[i].t_), std::move_if_noexcept(values_[i].t_));
+          }
+        }
+#if !OPTIONAL_NO_EXCEPTIONS
+      }
+      catch (...)
+      {
+        while (i-- != 0)
+        {
+          if (has_value(i))
+          {
+            detail::destruct(values[i].t_);
+          }
+        }
+        deallocate(values, n);
+        throw;
+      }
+#endif
+      for (i = 0; i != size_; ++i)
+      {
+        if (has_value(i))
+        {
+          detail::destruct(values_[i].t_);
+        }
+      }
+    }
+
+    slot * values_ = nullptr;
+    std::vector<std::uint64_t> bits_;
+    size_type size_ = 0;
+    size_type capacity_ = 0;
+  };
+
+  template<class T>
+  void swap( optional_vector<T> & lhs, optional_vector<T> & rhs ) noexcept
+  {
+    lhs.swap(rhs);
+  }
+}
@@ -0,0 +1,201 @@
+#include <catch.hpp>
+#include <optional_aggregate.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+namespace compute = std::compute;
+
+template<class T>
+bool same_bits(const std::optional<T> & a, const std::optional<T> & b)
+{
+  return a.has_value() == b.has_value() && (!a || std::memcmp(&*a, &*b, sizeof(T)) == 0);
+}
+
+TEST_CASE("aggregates", "[aggregate]") {
+  std::optional_vector<int> v({3, std::nullopt, -7, 12, std::nullopt, 4});
+  REQUIRE(compute::count(v) == 4U);
+  REQUIRE(compute::sum(v).value() == 12);
+  REQUIRE(compute::min(v).value() == -7);
+  REQUIRE(compute::max(v).value() == 12);
+  REQUIRE(compute::mean(v).value() == 3.0);
+
+  std::vector<std::optional<int>> o{3, std::nullopt, -7, 12, std::nullopt, 4};
+  const std::optional<int> * first = o.data();
+  const std::optional<int> * last = o.data() + o.size();
+  REQUIRE(compute::count(first, last) == 4U);
+  REQUIRE(compute::sum(first, last).value() == 12);
+  REQUIRE(compute::min(first, last).value() == -7);
+  REQUIRE(compute::max(first, last).value() == 12);
+  REQUIRE(compute::mean(first, last).value() == 3.0);
+
+  SECTION("nothing engaged is empty") {
+    std::optional_vector<double> none(100);
+    REQUIRE(compute::count(none) == 0U);
+    REQUIRE(!compute::sum(none));
+    REQUIRE(!compute::min(none));
+    REQUIRE(!compute::max(none));
+    REQUIRE(!compute::mean(none));
+    REQUIRE(!compute::sum(std::optional_vector<double>()));
+  }
+  SECTION("sum types") {
+    std::optional_vector<std::uint8_t> bytes({200, 200, std::nullopt});
+    REQUIRE(compute::sum(bytes).value() == 400U);
+    static_assert(std::is_same<decltype(compute::sum(bytes)), std::optional<std::uint64_t>>::value, "");
+    static_assert(std::is_same<decltype(compute::sum(v)), std::optional<std::int64_t>>::value, "");
+    std::optional_vector<float> floats({0.5f, std::nullopt, 0.25f});
+    static_assert(std::is_same<decltype(compute::sum(floats)), std::optional<double>>::value, "");
+    REQUIRE(compute::sum(floats).value() == 0.75);
+  }
+  SECTION("infinite sums") {
+    const double inf = std::numeric_limits<double>::infinity();
+    std::optional_vector<double> d({1.0, inf, std::nullopt, 2.0});
+    REQUIRE(compute::sum(d).value() == inf);
+    REQUIRE(compute::mean(d).value() == inf);
+    std::vector<std::optional<double>> o{1.0, inf, std::nullopt, 2.0};
+    REQUIRE(compute::sum(o.data(), o.data() + o.size()).value() == inf);
+
+    // each in its own word, so the overflow happens in the compensated sum
+    std::optional_vector<double> big(130);
+    big.emplace(0, 1e308);
+    big.emplace(129, 1e308);
+    REQUIRE(compute::sum(big).value() == inf);
+    REQUIRE(compute::sum(std::optional_vector<double>({1e308, 1e308})).value() == inf);
+
+    std::optional_vector<double> opposite(130);
+    opposite.emplace(0, inf);
+    opposite.emplace(129, -inf);
+    REQUIRE(std::isnan(compute::sum(opposite).value()));
+    REQUIRE(std::isnan(compute::sum(std::optional_vector<double>({inf, -inf})).value()));
+  }
+  SECTION("a NaN makes min and max NaN wherever it is") {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (auto const & values : {std::vector<std::optional<double>>{nan, 1.0},
+                                std::vector<std::optional<double>>{1.0, nan},
+                                std::vector<std::optional<double>>{1.0, std::nullopt, nan, -1.0}})
+    {
+      std::optional_vector<double> d;
+      for (auto const & x : values)
+      {
+        d.push_back(x);
+      }
+      REQUIRE(std::isnan(compute::min(d).value()));
+      REQUIRE(std::isnan(compute::max(d).value()));
+      REQUIRE(std::isnan(compute::min(values.data(), values.data() + values.size()).value()));
+      REQUIRE(std::isnan(compute::max(values.data(), values.data() + values.size()).value()));
+    }
+    std::optional_vector<float> f(130);
+    f.emplace(0, 2.0f);
+    f.emplace(129, std::numeric_limits<float>::quiet_NaN());
+    REQUIRE(std::isnan(compute::min(f).value()));
+    REQUIRE(std::isnan(compute::max(f, 3).value()));
+    f.reset(129);
+    REQUIRE(compute::min(f).value() == 2.0f);
+  }
+  SECTION("infinities and integer limits") {
+    const double inf = std::numeric_limits<double>::infinity();
+    std::optional_vector<double> d({inf, std::nullopt, -inf});
+    REQUIRE(compute::min(d).value() == -inf);
+    REQUIRE(compute::max(d).value() == inf);
+    std::optional_vector<std::int64_t> i({std::numeric_limits<std::int64_t>::max(), std::nullopt});
+    REQUIRE(compute::min(i).value() == std::numeric_limits<std::int64_t>::max());
+    std::optional_vector<std::uint8_t> b({std::nullopt, 0});
+    REQUIRE(compute::max(b).value() == 0U);
+  }
+  SECTION("stale values are skipped") {
+    std::optional_vector<double> d({1.0, 2.0, 3.0});
+    d.reset(1);
+    d.emplace(2, std::numeric_limits<double>::quiet_NaN());
+    d.reset(2);
+    REQUIRE(compute::sum(d).value() == 1.0);
+    REQUIRE(compute::max(d).value() == 1.0);
+  }
+}
+
+std::optional_vector<double> random_column(std::size_t n, std::mt19937_64 & rng)
+{
+  std::bernoulli_distribution engaged(0.6);
+  std::uniform_real_distribution<double> mantissa(-1, 1);
+  std::uniform_int_distribution<int> exponent(-20, 20);
+  std::optional_vector<double> v;
+  v.reserve(n);
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    if (engaged(rng))
+    {
+      v.push_back(std::ldexp(mantissa(rng), exponent(rng)));
+    }
+    else
+    {
+      v.push_back(std::nullopt);
+    }
+  }
+  return v;
+}
+
+TEST_CASE("results do not depend on the thread count", "[aggregate]") {
+  std::mt19937_64 rng(11);
+  const std::size_t sizes[] = {0, 1, 63, 64, 65, 1000, detail::block_size - 1, 5 * detail::block_size + 77};
+  for (std::size_t n : sizes)
+  {
+    INFO("n " << n);
+    auto v = random_column(n, rng);
+    std::vector<std::optional<double>> o(n);
+    long double exact = 0;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      if (v.has_value(i))
+      {
+        o[i] = v.value(i);
+        exact += v.value(i);
+      }
+    }
+    const std::optional<double> * first = o.data();
+    const std::optional<double> * last = o.data() + n;
+
+    auto sum = compute::sum(v, 1);
+    auto min = compute::min(v, 1);
+    auto max = compute::max(v, 1);
+    REQUIRE(same_bits(compute::sum(first, last, 1), sum));
+    REQUIRE(same_bits(compute::min(first, last, 1), min));
+    REQUIRE(same_bits(compute::max(first, last, 1), max));
+    if (sum)
+    {
+      REQUIRE(std::fabs(*sum - static_cast<double>(exact)) <= 1e-9 * std::fabs(static_cast<double>(exact)) + 1e-12);
+    }
+    for (unsigned threads : {0U, 2U, 3U, 7U, 64U})
+    {
+      INFO("threads " << threads);
+      REQUIRE(same_bits(compute::sum(v, threads), sum));
+      REQUIRE(same_bits(compute::min(v, threads), min));
+      REQUIRE(same_bits(compute::max(v, threads), max));
+      REQUIRE(same_bits(compute::mean(v, threads), compute::mean(v, 1)));
+      REQUIRE(same_bits(compute::sum(first, last, threads), sum));
+    }
+  }
+}
+
+TEST_CASE("concurrent reductions share the pool", "[aggregate]") {
+  std::mt19937_64 rng(12);
+  auto v = random_column(9 * detail::block_size, rng);
+  auto sum = compute::sum(v, 1);
+  std::vector<std::optional<double>> results(4);
+  std::vector<std::thread> callers;
+  for (std::size_t c = 0; c != results.size(); ++c)
+  {
+    callers.emplace_back([&, c] { results[c] = compute::sum(v, 4); });
+  }
+  for (auto & caller : callers)
+  {
+    caller.join();
+  }
+  for (auto const & r : results)
+  {
+    REQUIRE(same_bits(r, sum));
+  }
+}
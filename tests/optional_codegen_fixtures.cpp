@@ -0,0 +1,76 @@
+// Compiled at -O2 into optional_codegen_ut, which disassembles these
+// functions from its own binary and checks them against budgets.  Keep
+// each to the one accessor it is named after.
+#include <optional.hpp>
+#include <string>
+
+struct Codegen_Pod
+{
+  int a[4];
+};
+
+namespace {
+  std::optional<int> half(int x)
+  {
+    return x % 2 ? std::optional<int>() : std::optional<int>(x / 2);
+  }
+}
+
+extern "C" {
+  bool codegen_has_value(const std::optional<int> & o)
+  {
+    return o.has_value();
+  }
+
+  int codegen_deref(const std::optional<int> & o)
+  {
+    return *o;
+  }
+
+  int codegen_value(const std::optional<int> & o)
+  {
+    return o.value();
+  }
+
+  void codegen_reset(std::optional<int> & o)
+  {
+    o.reset();
+  }
+
+  void codegen_swap(std::optional<int> & a, std::optional<int> & b)
+  {
+    a.swap(b);
+  }
+
+  void codegen_swap_pod(std::optional<Codegen_Pod> & a, std::optional<Codegen_Pod> & b)
+  {
+    a.swap(b);
+  }
+
+  std::size_t codegen_string_value(const std::optional<std::string> & o)
+  {
+    return o.value().size();
+  }
+
+  //! The same three lookups as a monadic chain and as an if ladder
+  int codegen_chain_monadic(const std::optional<int> & o)
+  {
+    return o.transform([](int x) { return x + 1; })
+            .and_then(half)
+            .transform([](int x) { return x * 3; })
+            .value_or(-1);
+  }
+
+  int codegen_chain_ladder(const std::optional<int> & o)
+  {
+    if (o)
+    {
+      std::optional<int> y = half(*o + 1);
+      if (y)
+      {
+        return *y * 3;
+      }
+    }
+    return -1;
+  }
+}
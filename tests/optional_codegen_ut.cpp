@@ -0,0 +1,143 @@
+#include <catch.hpp>
+#include <cstdio>
+#include <limits.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Checks the -O2 code of optional_codegen_fixtures.cpp, linked into this
+// binary, by disassembling it with objdump (OPTIONAL_OBJDUMP, found by
+// configure).  A function's .cold part, where GCC moves its throw site,
+// counts towards its calls but not its instructions.
+
+namespace {
+  struct instruction
+  {
+    std::string mnemonic;
+    std::string target; //!< the symbol a call or jump goes to, if any
+  };
+
+  std::string self_path()
+  {
+    char path[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    REQUIRE(n > 0);
+    return std::string(path, static_cast<std::size_t>(n));
+  }
+
+  bool is_padding(const std::string & text)
+  {
+    return text.compare(0, 3, "nop") == 0
+        || text.compare(0, 6, "data16") == 0
+        || text.compare(0, 3, "int3") == 0
+        || text.compare(0, 14, "xchg   %ax,%ax") == 0;
+  }
+
+  std::vector<instruction> disassemble(const std::string & symbol)
+  {
+    static const std::string self = self_path();
+    std::string command = std::string(OPTIONAL_OBJDUMP) + " -d --no-show-raw-insn --disassemble="
+      + symbol + " '" + self + "'";
+    FILE * pipe = popen(command.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    std::vector<instruction> result;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), pipe))
+    {
+      // "  401136:\tmov    (%rdi),%eax"
+      std::string s(line);
+      std::size_t tab = s.find(":\t");
+      if (tab == std::string::npos || s.find_first_not_of(" 0123456789abcdef") != tab)
+      {
+        continue;
+      }
+      std::string text = s.substr(tab + 2);
+      text.erase(text.find_last_not_of("\r\n") + 1);
+      if (text.empty() || is_padding(text))
+      {
+        continue;
+      }
+      instruction i;
+      i.mnemonic = text.substr(0, text.find(' '));
+      std::size_t open = text.find('<');
+      if (open != std::string::npos)
+      {
+        i.target = text.substr(open + 1, text.find_first_of("+>", open) - open - 1);
+      }
+      result.push_back(i);
+    }
+    REQUIRE(pclose(pipe) == 0);
+    return result;
+  }
+
+  struct profile
+  {
+    std::size_t instructions = 0;
+    std::vector<std::string> calls; //!< calls and tail jumps out, hot and cold
+  };
+
+  profile inspect(const std::string & symbol)
+  {
+    profile p;
+    std::vector<instruction> hot = disassemble(symbol);
+    REQUIRE(!hot.empty());
+    p.instructions = hot.size();
+    std::vector<instruction> all = hot;
+    std::vector<instruction> cold = disassemble(symbol + ".cold");
+    all.insert(all.end(), cold.begin(), cold.end());
+    for (const instruction & i : all)
+    {
+      bool call = i.mnemonic.compare(0, 4, "call") == 0;
+      bool jump_out = i.mnemonic.compare(0, 1, "j") == 0 && !i.target.empty()
+        && i.target != symbol && i.target != symbol + ".cold";
+      if (call || jump_out)
+      {
+        p.calls.push_back(i.target);
+      }
+    }
+    return p;
+  }
+
+  void require_budget(const std::string & symbol, std::size_t instructions)
+  {
+    INFO(symbol);
+    profile p = inspect(symbol);
+    CHECK(p.instructions <= instructions);
+    CHECK(p.calls.empty());
+  }
+
+  //! value(): its only call is the shared, out of line throw
+  void require_throw_site(const std::string & symbol, std::size_t instructions)
+  {
+    INFO(symbol);
+    profile p = inspect(symbol);
+    CHECK(p.instructions <= instructions);
+    REQUIRE(p.calls.size() <= 1);
+    for (const std::string & target : p.calls)
+    {
+      CHECK(target.find("throw_bad_optional_access") != std::string::npos);
+    }
+  }
+}
+
+TEST_CASE("accessors compile to a handful of instructions", "[codegen]") {
+  require_budget("codegen_has_value", 4);
+  require_budget("codegen_deref", 3);
+  require_budget("codegen_reset", 6);
+  require_throw_site("codegen_value", 5);
+  require_throw_site("codegen_string_value", 5);
+}
+
+//! Only the value and the flag move, never the optional's tail padding
+TEST_CASE("swap of trivially copyable values makes no calls", "[codegen]") {
+  require_budget("codegen_swap", 10);
+  require_budget("codegen_swap_pod", 9);
+}
+
+TEST_CASE("a monadic chain compiles like the if ladder", "[codegen]") {
+  profile ladder = inspect("codegen_chain_ladder");
+  profile monadic = inspect("codegen_chain_monadic");
+  CHECK(ladder.calls.empty());
+  CHECK(monadic.calls.empty());
+  CHECK(monadic.instructions <= ladder.instructions + 2);
+}
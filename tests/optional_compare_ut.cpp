@@ -0,0 +1,121 @@
+#include <catch.hpp>
+#include <optional_compare.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+namespace compute = std::compute;
+using compute::comparison;
+
+template<class T>
+bool holds(comparison op, T x, T s)
+{
+  switch (op)
+  {
+  case comparison::equal: return x == s;
+  case comparison::not_equal: return x != s;
+  case comparison::less: return x < s;
+  case comparison::less_equal: return x <= s;
+  case comparison::greater: return x > s;
+  case comparison::greater_equal: return x >= s;
+  }
+  return false;
+}
+
+const comparison all_comparisons[] = {
+  comparison::equal, comparison::not_equal, comparison::less,
+  comparison::less_equal, comparison::greater, comparison::greater_equal
+};
+
+template<class T>
+void check_compare(std::size_t n, std::mt19937 & rng)
+{
+  INFO("n " << n << " sizeof " << sizeof(T));
+  std::bernoulli_distribution engaged(0.8);
+  std::uniform_int_distribution<int> value(0, 6);
+  std::optional_vector<T> v;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    // small values around the scalar, including the extremes of T
+    int pick = value(rng);
+    T x = pick == 0 ? std::numeric_limits<T>::lowest() :
+          pick == 6 ? std::numeric_limits<T>::max() : static_cast<T>(pick);
+    v.push_back(x);
+    if (!engaged(rng))
+    {
+      v.reset(i);
+    }
+  }
+  for (comparison op : all_comparisons)
+  {
+    for (T s : {static_cast<T>(3), std::numeric_limits<T>::lowest(), std::numeric_limits<T>::max()})
+    {
+      std::optional_bool_vector r = compute::compare(v, op, s);
+      REQUIRE(r.size() == n);
+      for (std::size_t i = 0; i != n; ++i)
+      {
+        REQUIRE(r.has_value(i) == v.has_value(i));
+        if (v.has_value(i))
+        {
+          REQUIRE(r.value(i) == holds(op, v.value(i), s));
+        }
+      }
+      if (n % 64)
+      {
+        REQUIRE((r.bitmap()[n / 64] >> (n % 64)) == 0U);
+        REQUIRE((r.values()[n / 64] >> (n % 64)) == 0U);
+      }
+    }
+  }
+}
+
+TEST_CASE("compare against a scalar", "[compare]") {
+  std::mt19937 rng(3);
+  for (std::size_t n : {0, 1, 63, 64, 65, 200, 1000})
+  {
+    check_compare<std::int8_t>(n, rng);
+    check_compare<std::uint8_t>(n, rng);
+    check_compare<std::int16_t>(n, rng);
+    check_compare<std::uint16_t>(n, rng);
+    check_compare<std::int32_t>(n, rng);
+    check_compare<std::uint32_t>(n, rng);
+    check_compare<std::int64_t>(n, rng);
+    check_compare<std::uint64_t>(n, rng);
+    check_compare<long>(n, rng);
+    check_compare<char>(n, rng);
+    check_compare<float>(n, rng);
+    check_compare<double>(n, rng);
+  }
+}
+
+TEST_CASE("compare with NaN", "[compare]") {
+  std::optional_vector<double> v;
+  for (int i = 0; i != 100; ++i)
+  {
+    v.push_back(i % 2 ? std::nan("") : 1.0);
+  }
+  auto eq = compute::compare(v, comparison::equal, 1.0);
+  auto ne = compute::compare(v, comparison::not_equal, 1.0);
+  auto ge = compute::compare(v, comparison::greater_equal, 1.0);
+  for (std::size_t i = 0; i != v.size(); ++i)
+  {
+    REQUIRE(eq.value(i) == (i % 2 == 0));
+    REQUIRE(ne.value(i) == (i % 2 == 1));
+    REQUIRE(ge.value(i) == (i % 2 == 0));
+  }
+  REQUIRE(compute::count_null(compute::compare(v, comparison::less, std::nan(""))) == 0U);
+  REQUIRE(compute::count_true(compute::compare(v, comparison::less, std::nan(""))) == 0U);
+}
+
+TEST_CASE("compare into bitmaps", "[compare]") {
+  std::vector<int> values{5, 1, 9, 3};
+  std::uint64_t bitmap = 0xb | ~std::uint64_t(0xf);  // stray bits past n
+  std::uint64_t valid;
+  std::uint64_t result;
+  compute::compare(values.data(), &bitmap, values.size(), comparison::greater, 2, &valid, &result);
+  REQUIRE(valid == 0xbU);
+  REQUIRE(result == 0x9U);
+}
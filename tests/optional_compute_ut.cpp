@@ -0,0 +1,193 @@
+#include <catch.hpp>
+#include <optional_compute.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+namespace compute = std::compute;
+
+template<class T>
+std::optional_vector<T> column(std::initializer_list<std::optional<T>> values)
+{
+  return std::optional_vector<T>(values);
+}
+
+template<class T>
+std::vector<std::optional<T>> to_optionals(const std::optional_vector<T> & v)
+{
+  std::vector<std::optional<T>> out;
+  for (std::size_t i = 0; i != v.size(); ++i)
+  {
+    out.push_back(v.has_value(i) ? std::optional<T>(v.value(i)) : std::optional<T>());
+  }
+  return out;
+}
+
+template<class T>
+bool same(const std::vector<std::optional<T>> & a, const std::vector<std::optional<T>> & b)
+{
+  if (a.size() != b.size())
+  {
+    return false;
+  }
+  for (std::size_t i = 0; i != a.size(); ++i)
+  {
+    if (a[i].has_value() != b[i].has_value() || (a[i] && *a[i] != *b[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<class T>
+void check_bits_past_size(const std::optional_vector<T> & v)
+{
+  if (v.size() % 64)
+  {
+    REQUIRE((v.bitmap()[v.size() / 64] >> (v.size() % 64)) == 0U);
+  }
+}
+
+TEST_CASE("arithmetic", "[compute]") {
+  auto a = column<int>({1, 2, std::nullopt, 4, 5, std::nullopt});
+  auto b = column<int>({10, std::nullopt, 30, 0, 2, std::nullopt});
+
+  REQUIRE(same(to_optionals(compute::add(a, b)), {11, std::nullopt, std::nullopt, 4, 7, std::nullopt}));
+  REQUIRE(same(to_optionals(compute::sub(a, b)), {-9, std::nullopt, std::nullopt, 4, 3, std::nullopt}));
+  REQUIRE(same(to_optionals(compute::mul(a, b)), {10, std::nullopt, std::nullopt, 0, 10, std::nullopt}));
+  REQUIRE(same(to_optionals(compute::div(b, a)), {10, std::nullopt, std::nullopt, 0, 0, std::nullopt}));
+  REQUIRE(same(to_optionals(compute::min(a, b)), {1, std::nullopt, std::nullopt, 0, 2, std::nullopt}));
+  REQUIRE(same(to_optionals(compute::max(a, b)), {10, std::nullopt, std::nullopt, 4, 5, std::nullopt}));
+
+  SECTION("columns of different sizes") {
+    auto shorter = column<int>({1, 2});
+    REQUIRE_THROWS_AS(compute::add(a, shorter), std::length_error);
+    REQUIRE_THROWS_AS(compute::eq(shorter, a), std::length_error);
+  }
+  SECTION("integer division by zero is empty") {
+    REQUIRE(same(to_optionals(compute::div(a, b)), {0, std::nullopt, std::nullopt, std::nullopt, 2, std::nullopt}));
+    auto lowest = column<int>({std::numeric_limits<int>::lowest()});
+    auto minus_one = column<int>({-1});
+    REQUIRE(!compute::div(lowest, minus_one).has_value(0));
+  }
+  SECTION("integer overflow wraps") {
+    auto big = column<int>({std::numeric_limits<int>::max()});
+    auto one = column<int>({1});
+    REQUIRE(compute::add(big, one).value(0) == std::numeric_limits<int>::lowest());
+    auto small = column<std::uint8_t>({200});
+    REQUIRE(compute::mul(small, small).value(0) == std::uint8_t(200 * 200));
+  }
+  SECTION("floating point") {
+    auto x = column<double>({1.0, std::nullopt, 3.0});
+    auto y = column<double>({0.0, 1.0, 2.0});
+    auto q = compute::div(x, y);
+    REQUIRE(std::isinf(q.value(0)));
+    REQUIRE(!q.has_value(1));
+    REQUIRE(q.value(2) == 1.5);
+  }
+}
+
+TEST_CASE("comparisons", "[compute]") {
+  auto a = column<double>({1, 2, std::nullopt, 4});
+  auto b = column<double>({1, 3, 3, 3});
+  REQUIRE(same(to_optionals(compute::eq(a, b)), {true, false, std::nullopt, false}));
+  REQUIRE(same(to_optionals(compute::ne(a, b)), {false, true, std::nullopt, true}));
+  REQUIRE(same(to_optionals(compute::lt(a, b)), {false, true, std::nullopt, false}));
+  REQUIRE(same(to_optionals(compute::le(a, b)), {true, true, std::nullopt, false}));
+  REQUIRE(same(to_optionals(compute::gt(a, b)), {false, false, std::nullopt, true}));
+  REQUIRE(same(to_optionals(compute::ge(a, b)), {true, false, std::nullopt, true}));
+}
+
+template<class T>
+std::optional_vector<T> random_column(std::size_t n, double density, std::mt19937 & rng)
+{
+  std::bernoulli_distribution engaged(density);
+  std::uniform_int_distribution<int> value(-1000, 1000);
+  std::optional_vector<T> v;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    if (engaged(rng))
+    {
+      v.push_back(static_cast<T>(value(rng)));
+    }
+    else
+    {
+      v.push_back(std::nullopt);
+    }
+  }
+  return v;
+}
+
+template<class T>
+void check_against_optionals(std::size_t n, std::mt19937 & rng)
+{
+  INFO("n " << n << " sizeof " << sizeof(T));
+  auto a = random_column<T>(n, 0.7, rng);
+  auto b = random_column<T>(n, 0.7, rng);
+  auto c = random_column<T>(n, 0.2, rng);
+  // reset slots keep stale values, which must not leak into results
+  for (std::size_t i = 0; i < n; i += 5)
+  {
+    a.reset(i);
+  }
+  auto oa = to_optionals(a);
+  auto ob = to_optionals(b);
+  auto oc = to_optionals(c);
+
+  std::vector<std::optional<T>> out(n);
+  compute::add(oa.data(), ob.data(), n, out.data());
+  REQUIRE(same(to_optionals(compute::add(a, b)), out));
+  compute::div(oa.data(), ob.data(), n, out.data());
+  REQUIRE(same(to_optionals(compute::div(a, b)), out));
+  check_bits_past_size(compute::div(a, b));
+
+  std::vector<std::optional<bool>> cmp(n);
+  compute::lt(oa.data(), ob.data(), n, cmp.data());
+  REQUIRE(same(to_optionals(compute::lt(a, b)), cmp));
+
+  std::vector<T> filled(n);
+  compute::fill_null(oa.data(), n, 7, filled.data());
+  REQUIRE(compute::fill_null(a, 7) == filled);
+
+  std::vector<std::optional<T>> ab(n);
+  std::vector<std::optional<T>> abc(n);
+  compute::coalesce(oa.data(), ob.data(), n, ab.data());
+  compute::coalesce(ab.data(), oc.data(), n, abc.data());
+  REQUIRE(same(to_optionals(compute::coalesce(a, b)), ab));
+  REQUIRE(same(to_optionals(compute::coalesce(a, b, c)), abc));
+  REQUIRE(same(to_optionals(compute::coalesce(a)), oa));
+  check_bits_past_size(compute::coalesce(a, b, c));
+}
+
+TEST_CASE("columns match optional arrays", "[compute]") {
+  std::mt19937 rng(7);
+  for (std::size_t n : {0, 1, 5, 63, 64, 65, 200, 1031})
+  {
+    check_against_optionals<std::int32_t>(n, rng);
+    check_against_optionals<std::int64_t>(n, rng);
+    check_against_optionals<float>(n, rng);
+    check_against_optionals<double>(n, rng);
+    check_against_optionals<std::int16_t>(n, rng);
+    check_against_optionals<std::uint8_t>(n, rng);
+  }
+}
+
+TEST_CASE("fill_null and coalesce", "[compute]") {
+  auto a = column<double>({1.5, std::nullopt, std::nullopt, 4.5});
+  auto b = column<double>({std::nullopt, 2.5, std::nullopt, 0.5});
+  REQUIRE(compute::fill_null(a, 0) == (std::vector<double>{1.5, 0, 0, 4.5}));
+  REQUIRE(same(to_optionals(compute::coalesce(a, b)), {1.5, 2.5, std::nullopt, 4.5}));
+  REQUIRE(same(to_optionals(compute::coalesce(b, a)), {1.5, 2.5, std::nullopt, 0.5}));
+  REQUIRE_THROWS_AS(compute::coalesce(a, b, column<double>({1.0})), std::length_error);
+
+  std::vector<std::optional<double>> x{1.0, std::nullopt};
+  std::vector<std::optional<double>> y{std::nullopt, 2.0};
+  compute::coalesce(x.data(), y.data(), 2, x.data());
+  REQUIRE(x[0].value() == 1.0);
+  REQUIRE(x[1].value() == 2.0);
+}
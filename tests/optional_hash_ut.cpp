@@ -0,0 +1,105 @@
+#include <catch.hpp>
+#include <optional_hash.hpp>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+namespace compute = std::compute;
+
+//! The scalar definition the SIMD paths must reproduce
+std::uint64_t reference(std::uint64_t prev, bool engaged, std::uint64_t key)
+{
+  return detail::hash_step(prev, engaged ? key : detail::hash_empty_key);
+}
+
+TEST_CASE("hash kernels", "[hash]") {
+  std::mt19937_64 rng(9);
+  std::bernoulli_distribution engaged(0.7);
+  for (std::size_t n : {0, 1, 3, 63, 64, 65, 130, 1000})
+  {
+    INFO("n " << n);
+    std::optional_vector<std::int64_t> column;
+    std::vector<std::optional<std::int64_t>> optionals(n);
+    std::vector<std::uint64_t> expected(n);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      std::int64_t x = static_cast<std::int64_t>(rng());
+      bool e = engaged(rng);
+      column.push_back(x);
+      if (!e)
+      {
+        column.reset(i);
+      }
+      else
+      {
+        optionals[i] = x;
+      }
+      expected[i] = reference(0, e, static_cast<std::uint64_t>(x));
+    }
+
+    std::vector<std::uint64_t> out(n + 1, 12345);
+    compute::hash(column, out.data());
+    REQUIRE(std::equal(expected.begin(), expected.end(), out.begin()));
+    REQUIRE(out[n] == 12345U);
+
+    std::vector<std::uint64_t> from_optionals(n);
+    compute::hash(optionals.data(), n, from_optionals.data());
+    REQUIRE(std::equal(expected.begin(), expected.end(), from_optionals.begin()));
+
+    std::vector<std::uint64_t> combined = out;
+    compute::hash_combine(column, combined.data());
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      REQUIRE(combined[i] == reference(out[i], column.has_value(i), static_cast<std::uint64_t>(optionals[i].value_or(0))));
+    }
+  }
+}
+
+TEST_CASE("hash keys", "[hash]") {
+  SECTION("equal values hash equal across types") {
+    std::optional_vector<std::int32_t> narrow({-1, 7, std::nullopt});
+    std::optional_vector<std::int64_t> wide({-1, 7, std::nullopt});
+    std::uint64_t a[3];
+    std::uint64_t b[3];
+    compute::hash(narrow, a);
+    compute::hash(wide, b);
+    REQUIRE(std::equal(a, a + 3, b));
+
+    std::optional_vector<double> zeros({0.0, -0.0});
+    compute::hash(zeros, a);
+    REQUIRE(a[0] == a[1]);
+  }
+  SECTION("empty is distinct from every small value") {
+    std::vector<std::optional<int>> values(1000);
+    for (int i = 1; i != 1000; ++i)
+    {
+      values[i] = i - 500;
+    }
+    std::vector<std::uint64_t> out(values.size());
+    compute::hash(values.data(), values.size(), out.data());
+    REQUIRE(std::set<std::uint64_t>(out.begin(), out.end()).size() == values.size());
+  }
+  SECTION("combining is order sensitive") {
+    std::optional_vector<int> x({1, 2});
+    std::optional_vector<int> y({2, 1});
+    std::uint64_t xy[2];
+    std::uint64_t yx[2];
+    compute::hash(x, xy);
+    compute::hash_combine(y, xy);
+    compute::hash(y, yx);
+    compute::hash_combine(x, yx);
+    REQUIRE(xy[0] != yx[0]);
+    REQUIRE(xy[0] != xy[1]);
+  }
+  SECTION("other types go through std::hash") {
+    std::optional_vector<std::string> strings({std::string("a"), std::nullopt, std::string("a")});
+    std::uint64_t out[3];
+    compute::hash(strings, out);
+    REQUIRE(out[0] == out[2]);
+    REQUIRE(out[0] == reference(0, true, std::hash<std::string>()("a")));
+    REQUIRE(out[1] == reference(0, false, 0));
+  }
+}
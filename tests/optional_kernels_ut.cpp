@@ -0,0 +1,173 @@
+#include <catch.hpp>
+#include <optional_kernels.hpp>
+#include <random>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+struct Rgb
+{
+  unsigned char r, g, b;
+  bool operator==(const Rgb & o) const { return r == o.r && g == o.g && b == o.b; }
+};
+
+struct Wide
+{
+  std::uint64_t a, b;
+  bool operator==(const Wide & o) const { return a == o.a && b == o.b; }
+};
+
+template<class T>
+T make_value(std::size_t i)
+{
+  return static_cast<T>(i * 7 + 1);
+}
+
+template<>
+Rgb make_value<Rgb>(std::size_t i)
+{
+  return Rgb{static_cast<unsigned char>(i), static_cast<unsigned char>(i >> 8), 3};
+}
+
+template<>
+Wide make_value<Wide>(std::size_t i)
+{
+  return Wide{i, ~i};
+}
+
+template<class T>
+void check_bitmap_kernels(std::size_t n, double density, std::mt19937 & rng)
+{
+  std::bernoulli_distribution engaged(density);
+  std::vector<T> values(n);
+  // stray set bits past n must be ignored
+  std::vector<std::uint64_t> bitmap(detail::bitmap_words(n) + 1, 0);
+  std::vector<T> expected;
+  std::size_t first = n;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    values[i] = make_value<T>(i);
+    if (engaged(rng))
+    {
+      bitmap[i / 64] |= std::uint64_t(1) << (i % 64);
+      expected.push_back(values[i]);
+      first = std::min(first, i);
+    }
+  }
+  for (std::size_t i = n; i != bitmap.size() * 64; ++i)
+  {
+    bitmap[i / 64] |= std::uint64_t(1) << (i % 64);
+  }
+
+  INFO("n " << n << " density " << density << " sizeof " << sizeof(T));
+  REQUIRE(std::count_engaged(bitmap.data(), n) == expected.size());
+  REQUIRE(std::first_engaged(bitmap.data(), n) == first);
+
+  std::vector<T> dense(expected.size());
+  REQUIRE(std::compact(values.data(), bitmap.data(), n, dense.data()) == dense.data() + dense.size());
+  REQUIRE(dense == expected);
+
+  std::vector<T> out(n, make_value<T>(12345));
+  REQUIRE(std::expand(dense.data(), bitmap.data(), n, out.data()) == dense.data() + dense.size());
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    bool set = (bitmap[i / 64] >> (i % 64)) & 1;
+    REQUIRE(out[i] == (set ? values[i] : make_value<T>(12345)));
+  }
+}
+
+template<class T>
+void check_bitmap_kernels()
+{
+  std::mt19937 rng(42);
+  for (std::size_t n : {0, 1, 7, 8, 9, 63, 64, 65, 127, 128, 300, 513, 2048, 4099})
+  {
+    for (double density : {0.0, 0.03, 0.5, 0.97, 1.0})
+    {
+      check_bitmap_kernels<T>(n, density, rng);
+    }
+  }
+}
+
+TEST_CASE("instruction set", "[kernels]") {
+#if defined(__AVX512F__)
+  WARN("AVX-512 kernels");
+#elif defined(__AVX2__)
+  WARN("AVX2 kernels");
+#else
+  WARN("scalar kernels");
+#endif
+}
+
+TEST_CASE("bitmap kernels", "[kernels]") {
+  SECTION("4 bytes") {
+    check_bitmap_kernels<std::int32_t>();
+    check_bitmap_kernels<float>();
+  }
+  SECTION("8 bytes") {
+    check_bitmap_kernels<std::int64_t>();
+    check_bitmap_kernels<double>();
+  }
+  SECTION("other sizes") {
+    check_bitmap_kernels<std::uint8_t>();
+    check_bitmap_kernels<std::uint16_t>();
+    check_bitmap_kernels<Rgb>();
+    check_bitmap_kernels<Wide>();
+  }
+  SECTION("first engaged") {
+    std::vector<std::uint64_t> bitmap(40, 0);
+    REQUIRE(std::first_engaged(bitmap.data(), 40 * 64) == 40U * 64U);
+    bitmap[37] = std::uint64_t(1) << 5;
+    REQUIRE(std::first_engaged(bitmap.data(), 40 * 64) == 37U * 64U + 5U);
+    REQUIRE(std::first_engaged(bitmap.data(), 37 * 64 + 5) == 37U * 64U + 5U);
+    REQUIRE(std::first_engaged(bitmap.data(), 37 * 64 + 6) == 37U * 64U + 5U);
+  }
+}
+
+TEST_CASE("optional_vector kernels", "[kernels]") {
+  std::optional_vector<double> v;
+  for (int i = 0; i != 1000; ++i)
+  {
+    if (i % 3 == 2)
+    {
+      v.push_back(i * 0.5);
+    }
+    else
+    {
+      v.push_back(std::nullopt);
+    }
+  }
+  REQUIRE(std::count_engaged(v) == 333U);
+  REQUIRE(std::first_engaged(v) == 2U);
+  std::vector<double> dense(333);
+  REQUIRE(std::compact(v, dense.data()) == dense.data() + 333);
+  REQUIRE(dense[0] == 1.0);
+  REQUIRE(dense[332] == 998 * 0.5);
+}
+
+TEST_CASE("optional ranges", "[kernels]") {
+  std::vector<std::optional<int>> v{1, std::nullopt, 3, std::nullopt, std::nullopt, 6};
+  const std::optional<int> * first = v.data();
+  const std::optional<int> * last = v.data() + v.size();
+  REQUIRE(std::count_engaged(first, last) == 3U);
+  REQUIRE(std::first_engaged(first, last) == first);
+  REQUIRE(std::first_engaged(first + 1, last) == first + 2);
+  REQUIRE(std::first_engaged(first + 3, first + 5) == first + 5);
+
+  std::vector<int> dense;
+  std::compact(first, last, std::back_inserter(dense));
+  REQUIRE(dense == (std::vector<int>{1, 3, 6}));
+
+  std::vector<long> results{10, 30, 60};
+  std::vector<std::optional<long>> out(v.size(), std::optional<long>(-1));
+  REQUIRE(std::expand(results.cbegin(), first, last, out.data()) == results.cend());
+  REQUIRE(out[0].value() == 10);
+  REQUIRE(!out[1]);
+  REQUIRE(out[2].value() == 30);
+  REQUIRE(!out[3]);
+  REQUIRE(!out[4]);
+  REQUIRE(out[5].value() == 60);
+
+  std::vector<std::optional<double>> sentinel{1.5, std::nullopt, 2.5};
+  REQUIRE(std::count_engaged(sentinel.data(), sentinel.data() + 3) == 2U);
+}
@@ -0,0 +1,169 @@
+#include <catch.hpp>
+#include <optional_logic.hpp>
+#include <optional_compute.hpp>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Built once per instruction set the machine supports, see wscript_build.
+
+namespace compute = std::compute;
+
+using truth = std::optional<bool>;
+
+truth kleene_and(truth a, truth b)
+{
+  if ((a && !*a) || (b && !*b))
+  {
+    return false;
+  }
+  return a && b ? truth(true) : truth();
+}
+
+truth kleene_or(truth a, truth b)
+{
+  if ((a && *a) || (b && *b))
+  {
+    return true;
+  }
+  return a && b ? truth(false) : truth();
+}
+
+bool same(truth a, truth b)
+{
+  return a.has_value() == b.has_value() && (!a || *a == *b);
+}
+
+void check_invariant(const std::optional_bool_vector & v)
+{
+  for (std::size_t w = 0; w != detail::bitmap_words(v.size()); ++w)
+  {
+    REQUIRE((v.values()[w] & ~v.bitmap()[w]) == 0U);
+  }
+  if (v.size() % 64)
+  {
+    REQUIRE((v.bitmap()[v.size() / 64] >> (v.size() % 64)) == 0U);
+  }
+}
+
+TEST_CASE("truth tables", "[logic]") {
+  const truth values[] = {truth(), truth(false), truth(true)};
+  std::optional_bool_vector a;
+  std::optional_bool_vector b;
+  for (truth x : values)
+  {
+    for (truth y : values)
+    {
+      a.push_back(x);
+      b.push_back(y);
+    }
+  }
+  auto conj = compute::logical_and(a, b);
+  auto disj = compute::logical_or(a, b);
+  auto neg = compute::logical_not(a);
+  for (std::size_t i = 0; i != a.size(); ++i)
+  {
+    REQUIRE(same(conj[i], kleene_and(a[i], b[i])));
+    REQUIRE(same(disj[i], kleene_or(a[i], b[i])));
+    REQUIRE(same(neg[i], a[i] ? truth(!*a[i]) : truth()));
+    REQUIRE(compute::is_true(a)[i].value() == (a[i] && *a[i]));
+    REQUIRE(compute::is_false(a)[i].value() == (a[i] && !*a[i]));
+    REQUIRE(compute::is_null(a)[i].value() == !a[i]);
+  }
+}
+
+TEST_CASE("reductions", "[logic]") {
+  std::optional_bool_vector v{true, std::nullopt, false, true};
+  REQUIRE(compute::count_true(v) == 2U);
+  REQUIRE(compute::count_false(v) == 1U);
+  REQUIRE(compute::count_null(v) == 1U);
+  REQUIRE(compute::any(v).value());
+  REQUIRE(!compute::all(v).value());
+
+  REQUIRE(!compute::any(std::optional_bool_vector{false, std::nullopt}).has_value());
+  REQUIRE(!compute::all(std::optional_bool_vector{true, std::nullopt}).has_value());
+  REQUIRE(!compute::any(std::optional_bool_vector{false}).value());
+  REQUIRE(compute::all(std::optional_bool_vector{true}).value());
+  REQUIRE(!compute::any(std::optional_bool_vector()).value());
+  REQUIRE(compute::all(std::optional_bool_vector()).value());
+}
+
+TEST_CASE("column", "[logic]") {
+  std::optional_bool_vector v(3);
+  REQUIRE(compute::count_null(v) == 3U);
+  v.set(1, true);
+  v.set(2, false);
+  REQUIRE(!v[0]);
+  REQUIRE(v.value(1));
+  REQUIRE(!v.value(2));
+  REQUIRE_THROWS_AS(v.value(0), std::bad_optional_access);
+  REQUIRE_THROWS_AS(compute::logical_and(v, std::optional_bool_vector(4)), std::length_error);
+  REQUIRE_THROWS_AS(compute::logical_or(std::optional_bool_vector(2), v), std::length_error);
+  v.reset(1);
+  REQUIRE(!v.has_value(1));
+  check_invariant(v);
+
+  SECTION("from comparisons") {
+    std::optional_vector<int> a({1, 2, std::nullopt, 4});
+    std::optional_vector<int> b({1, 3, 3, 3});
+    std::optional_bool_vector eq(compute::eq(a, b));
+    REQUIRE(eq.size() == 4U);
+    REQUIRE(eq.value(0));
+    REQUIRE(!eq.value(1));
+    REQUIRE(!eq.has_value(2));
+    REQUIRE(!eq.value(3));
+    check_invariant(eq);
+  }
+  SECTION("shrinking clears the tail") {
+    std::optional_bool_vector t(130);
+    for (std::size_t i = 0; i != t.size(); ++i)
+    {
+      t.set(i, true);
+    }
+    t.resize(70);
+    check_invariant(t);
+    t.resize(130);
+    REQUIRE(compute::count_true(t) == 70U);
+    REQUIRE(compute::count_null(t) == 60U);
+  }
+}
+
+TEST_CASE("columns match element-wise logic", "[logic]") {
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> pick(0, 2);
+  for (std::size_t n : {0, 1, 63, 64, 65, 255, 256, 511, 512, 513, 1000, 4099})
+  {
+    INFO("n " << n);
+    std::vector<truth> x(n);
+    std::vector<truth> y(n);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      int a = pick(rng);
+      int b = pick(rng);
+      x[i] = a ? truth(a == 2) : truth();
+      y[i] = b ? truth(b == 2) : truth();
+    }
+    std::optional_bool_vector a(x.data(), x.data() + n);
+    std::optional_bool_vector b(y.data(), y.data() + n);
+    auto conj = compute::logical_and(a, b);
+    auto disj = compute::logical_or(a, b);
+    auto neg = compute::logical_not(a);
+    std::size_t trues = 0;
+    std::size_t nulls = 0;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      REQUIRE(same(conj[i], kleene_and(x[i], y[i])));
+      REQUIRE(same(disj[i], kleene_or(x[i], y[i])));
+      REQUIRE(same(neg[i], x[i] ? truth(!*x[i]) : truth()));
+      trues += x[i] && *x[i];
+      nulls += !x[i];
+    }
+    check_invariant(conj);
+    check_invariant(disj);
+    check_invariant(neg);
+    check_invariant(compute::is_null(a));
+    REQUIRE(compute::count_true(a) == trues);
+    REQUIRE(compute::count_null(a) == nulls);
+    REQUIRE(compute::count_false(a) == n - trues - nulls);
+  }
+}
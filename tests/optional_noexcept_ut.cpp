@@ -0,0 +1,40 @@
+// Built with -fno-exceptions: a failed value() must reach the installed
+// handler instead of throwing.
+#include <optional.hpp>
+#include <cstdio>
+#include <cstdlib>
+
+static_assert(OPTIONAL_NO_EXCEPTIONS, "exceptions are enabled");
+
+static void on_bad_access()
+{
+  std::puts("bad_optional_access handler called");
+  std::fflush(stdout);
+  std::_Exit(EXIT_SUCCESS);
+}
+
+int main()
+{
+  if (std::get_bad_optional_access_handler() != &std::abort)
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::optional<int> engaged{1};
+  std::optional<double> sentinel;
+  sentinel.emplace(2.0);
+  if (engaged.value() != 1 || sentinel.value() != 2.0)
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::set_bad_optional_access_handler(&on_bad_access);
+  if (std::get_bad_optional_access_handler() != &on_bad_access)
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::optional<int> empty;
+  std::printf("%d\n", empty.value());
+  return EXIT_FAILURE;
+}
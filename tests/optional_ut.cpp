@@ -1,5 +1,13 @@
 #include <catch.hpp>
 #include <optional.hpp>
+#include "tracked.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 struct Trival_Destructor
 {
@@ -29,6 +37,642 @@ TEST_CASE("type traits", "[optional]") {
   }
 }
   
+struct Pod
+{
+  int x;
+  double y;
+};
+
+struct Non_Trivial_Copy
+{
+  Non_Trivial_Copy() = default;
+  Non_Trivial_Copy(Non_Trivial_Copy const &) {}
+  Non_Trivial_Copy(Non_Trivial_Copy &&) = default;
+  Non_Trivial_Copy & operator=(Non_Trivial_Copy const &) = default;
+  Non_Trivial_Copy & operator=(Non_Trivial_Copy &&) = default;
+};
+
+struct Move_Only
+{
+  Move_Only() = default;
+  Move_Only(Move_Only &&) = default;
+  Move_Only & operator=(Move_Only &&) = default;
+};
+
+template<class T>
+constexpr bool trivial_ladder()
+{
+  return std::is_trivially_copy_constructible<optional<T>>::value
+    && std::is_trivially_move_constructible<optional<T>>::value
+    && std::is_trivially_copy_assignable<optional<T>>::value
+    && std::is_trivially_move_assignable<optional<T>>::value
+    && std::is_trivially_destructible<optional<T>>::value
+    && std::is_trivially_copyable<optional<T>>::value;
+}
+
+TEST_CASE("trivial special members", "[optional]") {
+  SECTION("trivially copyable payloads") {
+    static_assert(trivial_ladder<int>(), "optional<int> not trivial");
+    static_assert(trivial_ladder<double>(), "optional<double> not trivial");
+    static_assert(trivial_ladder<Pod>(), "optional<Pod> not trivial");
+    static_assert(trivial_ladder<Trival_Destructor>(), "optional<Trival_Destructor> not trivial");
+  }
+
+  SECTION("non trivial payloads") {
+    static_assert(!std::is_trivially_copy_constructible<optional<Non_Trivial_Copy>>::value, "copy ctor");
+    static_assert(std::is_trivially_move_constructible<optional<Non_Trivial_Copy>>::value, "move ctor");
+    static_assert(!std::is_trivially_copy_assignable<optional<Non_Trivial_Copy>>::value, "copy assign");
+    static_assert(std::is_trivially_move_assignable<optional<Non_Trivial_Copy>>::value, "move assign");
+    static_assert(std::is_trivially_destructible<optional<Non_Trivial_Copy>>::value, "destructor");
+
+    static_assert(!std::is_trivially_copy_constructible<optional<Non_Trival_Destructor>>::value, "copy ctor");
+    static_assert(!std::is_trivially_copy_assignable<optional<Non_Trival_Destructor>>::value, "copy assign");
+    static_assert(!std::is_trivially_copyable<optional<Non_Trival_Destructor>>::value, "copyable");
+  }
+
+  SECTION("deleted special members follow T") {
+    static_assert(!std::is_copy_constructible<optional<Move_Only>>::value, "copy ctor");
+    static_assert(std::is_move_constructible<optional<Move_Only>>::value, "move ctor");
+    static_assert(!std::is_copy_assignable<optional<Move_Only>>::value, "copy assign");
+    static_assert(std::is_move_assignable<optional<Move_Only>>::value, "move assign");
+    static_assert(std::is_nothrow_move_constructible<optional<Move_Only>>::value, "noexcept move");
+  }
+}
+  
+struct Fd
+{
+  constexpr Fd(int f) : fd(f) {}
+  int fd;
+};
+
+struct Handle {};
+
+enum class Colour : unsigned char { red, green, blue, none = 0xff };
+
+namespace std {
+  template<>
+  struct optional_traits<Fd>
+  {
+    static constexpr Fd empty_value() noexcept
+    {
+      return Fd(-1);
+    }
+
+    static constexpr bool is_empty(Fd const & f) noexcept
+    {
+      return f.fd == -1;
+    }
+  };
+
+  template<>
+  struct optional_traits<Handle*> : optional_sentinel<Handle*, nullptr> {};
+
+  template<>
+  struct optional_traits<Colour> : optional_sentinel<Colour, Colour::none> {};
+}
+
+TEST_CASE("sentinel storage", "[optional]") {
+  SECTION("sizeof") {
+    static_assert(sizeof(optional<Fd>) == sizeof(Fd), "optional<Fd> has a flag");
+    static_assert(sizeof(optional<Handle*>) == sizeof(Handle*), "optional<Handle*> has a flag");
+    static_assert(sizeof(optional<Colour>) == sizeof(Colour), "optional<Colour> has a flag");
+    static_assert(sizeof(optional<int64_t>) == 2 * sizeof(int64_t), "optional<int64_t> is opt-in only");
+    static_assert(trivial_ladder<Fd>(), "optional<Fd> not trivial");
+  }
+
+  SECTION("constexpr") {
+    constexpr optional<Fd> empty;
+    static_assert(!empty.has_value(), "has value");
+    constexpr optional<Fd> engaged{Fd(3)};
+    static_assert(engaged.has_value(), "does not have value");
+    static_assert(engaged.value().fd == 3, "value incorrect");
+  }
+
+  SECTION("engage and reset") {
+    optional<Handle*> h;
+    REQUIRE(!h.has_value());
+    REQUIRE_THROWS_AS(h.value(), std::bad_optional_access);
+    Handle handle;
+    optional<Handle*> h2{&handle};
+    REQUIRE(h2.has_value());
+    REQUIRE(*h2 == &handle);
+    h = h2;
+    REQUIRE(h.has_value());
+    h2.reset();
+    REQUIRE(!h2.has_value());
+    REQUIRE(h.value() == &handle);
+  }
+
+  SECTION("storing the sentinel disengages") {
+    optional<Colour> c{Colour::none};
+    REQUIRE(!c.has_value());
+    optional<Colour> g{Colour::green};
+    REQUIRE(g.has_value());
+    g = c;
+    REQUIRE(!g.has_value());
+  }
+}
+
+template<class Float, class Bits>
+Bits bits_of(Float f)
+{
+  Bits b;
+  std::memcpy(&b, &f, sizeof(b));
+  return b;
+}
+
+template<class Float, class Bits>
+Float from_bits(Bits b)
+{
+  Float f;
+  std::memcpy(&f, &b, sizeof(f));
+  return f;
+}
+
+template<class Float, class Bits>
+bool round_trips(Bits b)
+{
+  optional<Float> o{from_bits<Float>(b)};
+  return o.has_value() && bits_of<Float, Bits>(*o) == b;
+}
+
+#if OPTIONAL_NAN_SENTINEL
+TEST_CASE("nan sentinel", "[optional]") {
+  SECTION("sizeof") {
+    static_assert(sizeof(optional<double>) == sizeof(double), "optional<double> has a flag");
+    static_assert(sizeof(optional<float>) == sizeof(float), "optional<float> has a flag");
+  }
+
+  SECTION("constexpr") {
+    constexpr optional<double> d{1.5};
+    static_assert(d.has_value(), "has_value() is constexpr");
+    static_assert(*d == 1.5, "operator* is constexpr");
+    static_assert(d == 1.5, "comparisons are constexpr");
+    static_assert(!optional<double>().has_value(), "");
+    constexpr optional<float> f{2.5f};
+    static_assert(f.has_value(), "has_value() is constexpr");
+    static_assert(f.value() == 2.5f, "value() is constexpr");
+    static_assert(!optional<float>().has_value(), "");
+  }
+
+  SECTION("empty and reset") {
+    optional<double> d;
+    REQUIRE(!d.has_value());
+    d = optional<double>{1.5};
+    REQUIRE(d.has_value());
+    REQUIRE(*d == 1.5);
+    d.reset();
+    REQUIRE(!d.has_value());
+    REQUIRE_THROWS_AS(d.value(), std::bad_optional_access);
+  }
+
+  SECTION("user visible doubles round trip") {
+    volatile double zero = 0.0;
+    double const values[] = {
+      0.0, -0.0, 1.0, -1.0,
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::max(),
+      std::numeric_limits<double>::lowest(),
+      std::numeric_limits<double>::denorm_min(),
+      std::numeric_limits<double>::quiet_NaN(),
+      -std::numeric_limits<double>::quiet_NaN(),
+      std::numeric_limits<double>::signaling_NaN(),
+      -std::numeric_limits<double>::signaling_NaN(),
+      zero / zero,
+      std::sqrt(-1.0 + zero),
+      std::nan(""),
+      std::nan("1"),
+      std::nan("0xbadf00d"),
+    };
+    for (double v : values)
+    {
+      REQUIRE(round_trips<double>(bits_of<double, uint64_t>(v)));
+    }
+  }
+
+  SECTION("every double nan payload round trips") {
+    uint64_t const exponent = 0x7ff0000000000000ULL;
+    uint64_t const sign = 0x8000000000000000ULL;
+    for (unsigned shift = 0; shift < 52; ++shift)
+    {
+      for (uint64_t low = 1; low < 16; ++low)
+      {
+        uint64_t const payload = (low << shift) & 0x000fffffffffffffULL;
+        if (payload == 0 || (exponent | payload) == std::optional_traits<double>::empty_bits)
+        {
+          continue;
+        }
+        REQUIRE(round_trips<double>(exponent | payload));
+        REQUIRE(round_trips<double>(sign | exponent | payload));
+      }
+    }
+    REQUIRE(round_trips<double>(sign | std::optional_traits<double>::empty_bits));
+    REQUIRE(!optional<double>{from_bits<double>(std::optional_traits<double>::empty_bits)}.has_value());
+  }
+
+  SECTION("every float nan round trips") {
+    uint32_t mismatches = 0;
+    for (uint32_t payload = 1; payload < 0x800000U; ++payload)
+    {
+      uint32_t const b = 0x7f800000U | payload;
+      if (b != std::optional_traits<float>::empty_bits && !round_trips<float>(b))
+      {
+        ++mismatches;
+      }
+      if (!round_trips<float>(0x80000000U | b))
+      {
+        ++mismatches;
+      }
+    }
+    REQUIRE(mismatches == 0U);
+    REQUIRE(!optional<float>{from_bits<float>(std::optional_traits<float>::empty_bits)}.has_value());
+  }
+}
+#endif
+
+// Plain aggregates are PODs, the ABI never reuses their tail padding.
+struct Pod_64_32 { int64_t a; int32_t b; };
+struct Pod_32_8 { int32_t a; int8_t b; };
+struct Pod_64_64 { int64_t a; int64_t b; };
+
+// Private members make these non-PODs, their tail padding can hold the flag.
+class Padded_64_32
+{
+  public:
+  Padded_64_32() = default;
+  Padded_64_32(int64_t a, int32_t b) : a_(a), b_(b) {}
+  int64_t a() const { return a_; }
+  int32_t b() const { return b_; }
+  private:
+  int64_t a_;
+  int32_t b_;
+};
+
+class Padded_32_8
+{
+  int32_t a_;
+  int8_t b_;
+};
+
+class Padded_double_16
+{
+  double a_;
+  int16_t b_;
+};
+
+class Packed_64_64
+{
+  int64_t a_;
+  int64_t b_;
+};
+
+struct Derived_Pod_64_32 : Pod_64_32 {};
+
+template<class T>
+struct Row : optional<T>
+{
+  int32_t column;
+};
+
+//! tag lives in optional<Pod_32_8>'s own tail padding
+struct Tagged_Row : optional<Pod_32_8>
+{
+  char tag;
+};
+
+TEST_CASE("tail padding", "[optional]") {
+  SECTION("sizeof table") {
+    //   T                  sizeof(T)  sizeof(optional<T>)  sizeof(Row<T>)
+    //   Pod_64_32          16         24                   24
+    //   Pod_32_8            8         12                   16
+    //   Pod_64_64          16         24                   24
+    //   Padded_64_32       16         16                   24
+    //   Padded_32_8         8          8                   12
+    //   Padded_double_16   16         16                   24
+    //   Packed_64_64       16         24                   24
+    //   Derived_Pod_64_32  16         24                   24
+    static_assert(sizeof(Pod_64_32) == 16 && sizeof(optional<Pod_64_32>) == 24, "Pod_64_32");
+    static_assert(sizeof(Pod_32_8) == 8 && sizeof(optional<Pod_32_8>) == 12, "Pod_32_8");
+    static_assert(sizeof(Pod_64_64) == 16 && sizeof(optional<Pod_64_64>) == 24, "Pod_64_64");
+    static_assert(sizeof(Padded_64_32) == 16 && sizeof(optional<Padded_64_32>) == 16, "Padded_64_32");
+    static_assert(sizeof(Padded_32_8) == 8 && sizeof(optional<Padded_32_8>) == 8, "Padded_32_8");
+    static_assert(sizeof(Padded_double_16) == 16 && sizeof(optional<Padded_double_16>) == 16, "Padded_double_16");
+    static_assert(sizeof(Packed_64_64) == 16 && sizeof(optional<Packed_64_64>) == 24, "Packed_64_64");
+    static_assert(sizeof(Derived_Pod_64_32) == 16 && sizeof(optional<Derived_Pod_64_32>) == 24, "Derived_Pod_64_32");
+  }
+
+  SECTION("flag after the value leaves the optional's own tail free") {
+    // with the flag in front Row<Pod_64_32> would be 32 bytes
+    static_assert(sizeof(Row<Pod_64_32>) == 24, "Row<Pod_64_32>");
+    static_assert(sizeof(Row<Pod_32_8>) == 16, "Row<Pod_32_8>");
+    static_assert(sizeof(Row<Padded_64_32>) == 24, "Row<Padded_64_32>");
+  }
+
+  SECTION("swap leaves the derived class's members alone") {
+    static_assert(sizeof(Tagged_Row) == sizeof(optional<Pod_32_8>), "tag reuses the tail");
+    Tagged_Row a;
+    Tagged_Row b;
+    a.emplace(Pod_32_8{1, 2});
+    a.tag = 'a';
+    b.tag = 'b';
+    a.swap(b);
+    REQUIRE(!a.has_value());
+    REQUIRE(b.value().a == 1);
+    REQUIRE(a.tag == 'a');
+    REQUIRE(b.tag == 'b');
+
+    Row<Padded_64_32> r;
+    Row<Padded_64_32> q;
+    r.emplace(3, 4);
+    r.column = 1;
+    q.column = 2;
+    r.swap(q);
+    REQUIRE(q.value().b() == 4);
+    REQUIRE(r.column == 1);
+    REQUIRE(q.column == 2);
+  }
+
+  SECTION("padding flag stays trivial") {
+    static_assert(trivial_ladder<Padded_64_32>(), "optional<Padded_64_32> not trivial");
+  }
+
+  SECTION("engage, copy and reset") {
+    optional<Padded_64_32> p;
+    REQUIRE(!p.has_value());
+    optional<Padded_64_32> q{Padded_64_32(-1, -1)};
+    REQUIRE(q.has_value());
+    REQUIRE((*q).a() == -1);
+    Padded_64_32 all_ones(-1, -1);
+    *q = all_ones;
+    REQUIRE(q.has_value());
+    p = q;
+    REQUIRE(p.has_value());
+    REQUIRE(p.value().b() == -1);
+    q.reset();
+    REQUIRE(!q.has_value());
+    REQUIRE_THROWS_AS(q.value(), std::bad_optional_access);
+    p = q;
+    REQUIRE(!p.has_value());
+  }
+}
+
+struct Empty_Tag {};
+
+struct Empty_Final final {};
+
+struct Stateless_Functor
+{
+  Stateless_Functor() {}
+  int operator()(int x) const { return x * 2; }
+};
+
+//! Empty, but its constructor and destructor are observable
+struct Counted_Empty
+{
+  static int alive;
+  Counted_Empty() { ++alive; }
+  Counted_Empty(const Counted_Empty &) { ++alive; }
+  explicit Counted_Empty(bool fail)
+  {
+    if (fail)
+    {
+      throw 1;
+    }
+    ++alive;
+  }
+  ~Counted_Empty() { --alive; }
+};
+
+int Counted_Empty::alive = 0;
+
+struct Holds_Optionals
+{
+  optional<Empty_Tag> tag;
+  optional<Stateless_Functor> functor;
+  char c;
+};
+
+TEST_CASE("empty types", "[optional]") {
+  SECTION("sizeof") {
+    auto lambda = [](int x) { return x + 1; };
+    static_assert(sizeof(optional<Empty_Tag>) == 1, "optional<Empty_Tag>");
+    // a final T can't be the storage's base, so it keeps a flag
+    static_assert(sizeof(optional<Empty_Final>) == 2, "optional<Empty_Final>");
+    static_assert(sizeof(optional<Stateless_Functor>) == 1, "optional<Stateless_Functor>");
+    static_assert(sizeof(optional<decltype(lambda)>) == 1, "optional<lambda>");
+    static_assert(sizeof(optional<Non_Trival_Destructor>) == 1, "optional<Non_Trival_Destructor>");
+    static_assert(sizeof(Holds_Optionals) == 3, "Holds_Optionals");
+    static_assert(trivial_ladder<Empty_Tag>(), "optional<Empty_Tag> not trivial");
+  }
+
+  SECTION("engage and reset") {
+    optional<Stateless_Functor> f;
+    REQUIRE(!f.has_value());
+    f = optional<Stateless_Functor>{Stateless_Functor()};
+    REQUIRE(f.has_value());
+    REQUIRE((*f)(2) == 4);
+    optional<Stateless_Functor> g{f};
+    REQUIRE(g.has_value());
+    f.reset();
+    REQUIRE(!f.has_value());
+    REQUIRE_THROWS_AS(f.value(), std::bad_optional_access);
+    g = f;
+    REQUIRE(!g.has_value());
+  }
+
+  SECTION("T is only alive while engaged") {
+    static_assert(sizeof(optional<Counted_Empty>) == 1, "optional<Counted_Empty>");
+    {
+      optional<Counted_Empty> e;
+      REQUIRE(Counted_Empty::alive == 0);
+      e.emplace();
+      REQUIRE(e.has_value());
+      REQUIRE(Counted_Empty::alive == 1);
+      optional<Counted_Empty> copy{e};
+      REQUIRE(Counted_Empty::alive == 2);
+      e.reset();
+      REQUIRE(!e.has_value());
+      REQUIRE(Counted_Empty::alive == 1);
+      REQUIRE_THROWS(e.emplace(true));
+      REQUIRE(!e.has_value());
+      e.emplace(false);
+      REQUIRE(Counted_Empty::alive == 2);
+    }
+    REQUIRE(Counted_Empty::alive == 0);
+  }
+}
+
+TEST_CASE("one byte bool", "[optional]") {
+  SECTION("sizeof") {
+#if OPTIONAL_ONE_BYTE_BOOL
+    static_assert(sizeof(optional<bool>) == 1, "optional<bool> has a flag");
+    static_assert(sizeof(optional<optional<bool>>) == 1, "optional<optional<bool>>");
+#else
+    constexpr optional<bool> b{true};
+    static_assert(b.has_value() && *b, "flag layout has_value() is constexpr");
+#endif
+    static_assert(trivial_ladder<bool>(), "optional<bool> not trivial");
+  }
+
+  SECTION("three states") {
+    optional<bool> null;
+    optional<bool> yes{true};
+    optional<bool> no{false};
+    REQUIRE(!null.has_value());
+    REQUIRE(yes.has_value());
+    REQUIRE(*yes);
+    REQUIRE(no.has_value());
+    REQUIRE(!*no);
+    REQUIRE_THROWS_AS(null.value(), std::bad_optional_access);
+
+    null = no;
+    REQUIRE(null.has_value());
+    REQUIRE(!*null);
+    *null = true;
+    REQUIRE(null.value());
+    yes.reset();
+    REQUIRE(!yes.has_value());
+    no = yes;
+    REQUIRE(!no.has_value());
+    no.emplace(false);
+    REQUIRE(no.has_value());
+    REQUIRE(!*no);
+  }
+
+  SECTION("nested") {
+    optional<optional<bool>> outer_empty;
+    optional<optional<bool>> inner_empty{optional<bool>()};
+    optional<optional<bool>> inner_false{optional<bool>{false}};
+    REQUIRE(!outer_empty.has_value());
+    REQUIRE(inner_empty.has_value());
+    REQUIRE(!inner_empty.value().has_value());
+    REQUIRE(inner_false.has_value());
+    REQUIRE(inner_false.value().has_value());
+    REQUIRE(!**inner_false);
+  }
+}
+
+TEST_CASE("nested optionals", "[optional]") {
+  SECTION("sizeof") {
+    static_assert(sizeof(optional<optional<int>>) == sizeof(optional<int>), "optional<optional<int>>");
+    static_assert(sizeof(optional<optional<Empty_Tag>>) == 1, "optional<optional<Empty_Tag>>");
+    static_assert(sizeof(optional<optional<Padded_64_32>>) == 16, "optional<optional<Padded_64_32>>");
+    static_assert(sizeof(optional<optional<Pod_64_32>>) == sizeof(optional<Pod_64_32>), "optional<optional<Pod_64_32>>");
+    static_assert(trivial_ladder<optional<int>>(), "optional<optional<int>> not trivial");
+  }
+
+  SECTION("outer and inner states are distinct") {
+    optional<optional<int>> outer_empty;
+    REQUIRE(!outer_empty.has_value());
+
+    optional<optional<int>> inner_empty{optional<int>()};
+    REQUIRE(inner_empty.has_value());
+    REQUIRE(!inner_empty.value().has_value());
+
+    optional<optional<int>> both{optional<int>{7}};
+    REQUIRE(both.has_value());
+    REQUIRE(**both == 7);
+
+    outer_empty = inner_empty;
+    REQUIRE(outer_empty.has_value());
+    REQUIRE(!outer_empty.value().has_value());
+    inner_empty.reset();
+    REQUIRE(!inner_empty.has_value());
+    *outer_empty = optional<int>{3};
+    REQUIRE(**outer_empty == 3);
+  }
+
+  SECTION("non trivial inner value") {
+    optional<optional<Non_Trivial_Copy>> a{optional<Non_Trivial_Copy>{Non_Trivial_Copy()}};
+    optional<optional<Non_Trivial_Copy>> b;
+    REQUIRE(!b.has_value());
+    b = a;
+    REQUIRE(b.has_value());
+    REQUIRE(b.value().has_value());
+    a.reset();
+    REQUIRE(!a.has_value());
+    optional<optional<Non_Trivial_Copy>> c{a};
+    REQUIRE(!c.has_value());
+  }
+}
+
+struct Base_Ref { int b = 1; };
+struct Derived_Ref : Base_Ref { int d = 2; };
+constexpr int four = 4;
+
+TEST_CASE("references", "[optional]") {
+  SECTION("a nullable pointer") {
+    static_assert(sizeof(optional<int&>) == sizeof(int*), "optional<int&>");
+    static_assert(sizeof(optional<Non_Trivial_Copy&>) == sizeof(void*), "optional<Non_Trivial_Copy&>");
+    static_assert(std::is_trivially_copyable<optional<Non_Trivial_Copy&>>::value, "optional<T&> not trivially copyable");
+    static_assert(trivial_ladder<optional<Move_Only&>>(), "optional<Move_Only&> not trivial");
+    static_assert(std::is_same<int&, optional<int&>::value_type>::value, "value_type");
+    static_assert(!std::is_constructible<optional<const int&>, int>::value, "bound a temporary");
+    static_assert(!std::is_constructible<optional<int&>, const int&>::value, "dropped const");
+    static_assert(std::is_constructible<optional<const int&>, int&>::value, "const int&");
+    static_assert(std::is_constructible<optional<Base_Ref&>, Derived_Ref&>::value, "derived to base");
+    static_assert(!std::is_constructible<optional<Derived_Ref&>, Base_Ref&>::value, "base to derived");
+  }
+
+  SECTION("observers") {
+    int x = 1;
+    optional<int&> empty;
+    REQUIRE(!empty);
+    REQUIRE_THROWS_AS(empty.value(), std::bad_optional_access);
+    optional<int&> r{x};
+    REQUIRE(r.has_value());
+    REQUIRE(&r.value() == &x);
+    REQUIRE(&*r == &x);
+    *r = 2;
+    REQUIRE(x == 2);
+    const optional<int&> c{r};
+    c.value() = 3;
+    REQUIRE(x == 3);
+
+    Derived_Ref d;
+    optional<Base_Ref&> b{d};
+    REQUIRE(b->b == 1);
+    optional<Derived_Ref&> od{d};
+    optional<const Base_Ref&> cb{od};
+    REQUIRE(&*cb == &d);
+  }
+
+  SECTION("assignment rebinds") {
+    int x = 1;
+    int y = 2;
+    optional<int&> r{x};
+    r = y;
+    REQUIRE(x == 1);
+    REQUIRE(&*r == &y);
+    r.emplace(x);
+    REQUIRE(&*r == &x);
+    optional<int&> s;
+    r.swap(s);
+    REQUIRE(!r);
+    REQUIRE(&*s == &x);
+    s = std::nullopt;
+    REQUIRE(!s);
+    s = r;
+    REQUIRE(!s);
+  }
+
+  SECTION("constexpr") {
+    constexpr optional<const int&> r{four};
+    static_assert(r.has_value() && *r == 4 && r.value() == 4, "constexpr observers");
+    constexpr optional<const int&> e;
+    static_assert(!e.has_value(), "constexpr empty");
+  }
+
+  SECTION("nested") {
+    int x = 1;
+    optional<optional<int&>> o{optional<int&>{x}};
+    REQUIRE(&**o == &x);
+    o.reset();
+    REQUIRE(!o);
+  }
+}
+
 TEST_CASE("member types", "[optional]") {
   static_assert(std::is_same<int, optional<int>::value_type>::value, "member type incorrect");
 }
@@ -40,7 +684,7 @@ TEST_CASE("constexpr", "[optional]") {
     static_assert(!static_cast<bool>(x), "does not have value");
   }
   SECTION("nollopt constructor") {
-    auto constexpr x = optional<Non_trival_constructor_constexpr>(std::nullopt_t());
+    auto constexpr x = optional<Non_trival_constructor_constexpr>(std::nullopt);
     static_assert(!x.has_value(), "does not have value");
     static_assert(!static_cast<bool>(x), "does not have value");
   }
@@ -60,6 +704,11 @@ TEST_CASE("constexpr", "[optional]") {
     static_assert(*const_cast<optional<int>&>(x) == 1, "Value incorrect");
     static_assert(std::is_same<int&, decltype(*const_cast<optional<int>&>(x))>::value, "type");
   }
+  SECTION("in_place") {
+    constexpr optional<int> x{std::in_place, 3};
+    static_assert(x.has_value(), "does not have value");
+    static_assert(*x == 3, "Value incorrect");
+  }
   SECTION("const operator*") {
     auto const constexpr x = optional<int>{1};
     static_assert(*x == 1, "Value incorrect");
@@ -67,53 +716,90 @@ TEST_CASE("constexpr", "[optional]") {
   }
 }
 
-struct Tracked
+//! std::string-like payload that counts its heap allocations
+struct Tracked_String
 {
-  Tracked() 
-  : value()
+  Tracked_String(const char * s)
   {
-    ++constructed__;
+    append(s);
   }
 
-  Tracked(int x) 
-    : value(x)
+  Tracked_String(const Tracked_String & x)
   {
+    append(x.data_);
   }
 
-  Tracked(Tracked && x)
-    : value(x.value)
+  Tracked_String(Tracked_String && x) noexcept
+    : data_(x.data_)
+    , size_(x.size_)
+    , capacity_(x.capacity_)
   {
-    x.value = 0;
-    ++moved__;
+    x.data_ = nullptr;
+    x.size_ = x.capacity_ = 0;
   }
-  
-  Tracked & operator=(Tracked && x)
+
+  Tracked_String & operator=(const Tracked_String & x)
   {
-    value = x.value;
-    x.value = 0;
-    ++moved__;
+    if (this != &x)
+    {
+      size_ = 0;
+      append(x.data_);
+    }
     return *this;
   }
-  
-  ~Tracked() {
-    ++destructed__;
+
+  Tracked_String & operator=(Tracked_String && x) noexcept
+  {
+    std::swap(data_, x.data_);
+    std::swap(size_, x.size_);
+    std::swap(capacity_, x.capacity_);
+    return *this;
+  }
+
+  Tracked_String & operator=(const char * s)
+  {
+    size_ = 0;
+    append(s);
+    return *this;
   }
-  static ssize_t destructed__;
-  static ssize_t constructed__;
-  static ssize_t moved__;
 
-  static void reset()
+  ~Tracked_String()
   {
-    destructed__ = 0U;
-    constructed__ = 0U;
-    moved__ = 0U;
+    delete[] data_;
   }
 
-  int value;
+  bool operator==(const char * s) const
+  {
+    return std::strcmp(data_ ? data_ : "", s) == 0;
+  }
+
+  static ssize_t allocations__;
+
+  private:
+  void append(const char * s)
+  {
+    std::size_t n = s ? std::strlen(s) : 0;
+    if (size_ + n + 1 > capacity_)
+    {
+      char * data = new char[size_ + n + 1];
+      ++allocations__;
+      if (data_)
+      {
+        std::memcpy(data, data_, size_);
+      }
+      delete[] data_;
+      data_ = data;
+      capacity_ = size_ + n + 1;
+    }
+    std::memcpy(data_ + size_, s ? s : "", n + 1);
+    size_ += n;
+  }
+
+  char * data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
 };
-ssize_t Tracked::destructed__(0);
-ssize_t Tracked::constructed__(0);
-ssize_t Tracked::moved__(0);
+ssize_t Tracked_String::allocations__(0);
 
 TEST_CASE("runtime", "[optional]") {
   SECTION("reset no value") {
@@ -157,6 +843,482 @@ TEST_CASE("runtime", "[optional]") {
   }
 }
 
+TEST_CASE("assignment", "[optional]") {
+  SECTION("nullopt") {
+    static_assert(noexcept(std::declval<optional<Tracked>&>() = std::nullopt), "noexcept");
+    optional<Tracked> t{Tracked(1)};
+    Tracked::reset();
+    t = std::nullopt;
+    REQUIRE(!t.has_value());
+    REQUIRE(Tracked::destructed__ == 1U);
+    t = std::nullopt;
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("value into engaged assigns in place") {
+    optional<Tracked> t{Tracked(1)};
+    Tracked::reset();
+    t = Tracked(2);
+    REQUIRE(t.value().value == 2);
+    REQUIRE(Tracked::move_assigned__ == 1U);
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("value into empty constructs") {
+    optional<Tracked> t;
+    Tracked::reset();
+    t = Tracked(2);
+    REQUIRE(t.value().value == 2);
+    REQUIRE(Tracked::moved__ == 1U);
+    REQUIRE(Tracked::move_assigned__ == 0U);
+  }
+  SECTION("scalars") {
+    optional<int> i;
+    i = 3;
+    REQUIRE(i.value() == 3);
+    i = {};
+    REQUIRE(!i.has_value());
+    optional<double> d;
+    d = 1;
+    REQUIRE(d.value() == 1.0);
+    optional<Fd> fd;
+    fd = Fd(4);
+    REQUIRE(fd.value().fd == 4);
+  }
+  SECTION("reassigning a string reuses its buffer") {
+    optional<Tracked_String> a{Tracked_String("a longer string")};
+    optional<Tracked_String> b{Tracked_String("short")};
+    optional<Tracked_String> empty;
+    Tracked_String::allocations__ = 0;
+    a = b;
+    REQUIRE(*a == "short");
+    a = "tiny";
+    REQUIRE(*a == "tiny");
+    a = std::move(b);
+    REQUIRE(*a == "short");
+    REQUIRE(Tracked_String::allocations__ == 0U);
+    a = empty;
+    REQUIRE(!a.has_value());
+    a = "rebuilt";
+    REQUIRE(*a == "rebuilt");
+    REQUIRE(Tracked_String::allocations__ == 1U);
+  }
+  SECTION("converting") {
+    optional<const char *> s{"converted"};
+    optional<const char *> none;
+    optional<Tracked_String> t{Tracked_String("a longer string")};
+    Tracked_String::allocations__ = 0;
+    t = s;
+    REQUIRE(*t == "converted");
+    REQUIRE(Tracked_String::allocations__ == 0U);
+    t = none;
+    REQUIRE(!t.has_value());
+    t = std::move(s);
+    REQUIRE(*t == "converted");
+    REQUIRE(Tracked_String::allocations__ == 1U);
+
+    optional<long> l;
+    optional<int> i{5};
+    l = i;
+    REQUIRE(l.value() == 5L);
+    l = optional<int>();
+    REQUIRE(!l.has_value());
+  }
+  SECTION("trivial where T allows") {
+    static_assert(std::is_trivially_copy_assignable<optional<int>>::value, "optional<int>");
+    static_assert(std::is_trivially_move_assignable<optional<Pod>>::value, "optional<Pod>");
+    static_assert(!std::is_copy_assignable<optional<Move_Only>>::value, "optional<Move_Only>");
+    static_assert(std::is_move_assignable<optional<Move_Only>>::value, "optional<Move_Only>");
+  }
+}
+
+TEST_CASE("in place", "[optional]") {
+  SECTION("in_place constructor") {
+    Tracked::reset();
+    {
+      optional<Tracked> t{std::in_place};
+      REQUIRE(t.has_value());
+      REQUIRE(Tracked::constructed__ == 1U);
+      REQUIRE(Tracked::moved__ == 0U);
+      REQUIRE(Tracked::destructed__ == 0U);
+    }
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("in_place constructor with arguments") {
+    Tracked::reset();
+    optional<Tracked> t{std::in_place, 5};
+    REQUIRE(t.value().value == 5);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 0U);
+  }
+  SECTION("in_place initializer_list") {
+    optional<std::vector<int>> v{std::in_place, {1, 2, 3}};
+    REQUIRE(v.has_value());
+    REQUIRE(v.value().size() == 3U);
+    optional<std::vector<int>> w{std::in_place, {1, 2}, std::allocator<int>()};
+    REQUIRE(w.value().size() == 2U);
+  }
+  SECTION("emplace into empty") {
+    Tracked::reset();
+    optional<Tracked> t;
+    Tracked & r = t.emplace(7);
+    REQUIRE(t.has_value());
+    REQUIRE(&r == &*t);
+    REQUIRE(r.value == 7);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 0U);
+  }
+  SECTION("emplace over a value") {
+    optional<Tracked> t{std::in_place, 1};
+    Tracked::reset();
+    t.emplace();
+    REQUIRE(t.value().value == 0);
+    REQUIRE(Tracked::constructed__ == 1U);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("emplace initializer_list") {
+    optional<std::vector<int>> v;
+    v.emplace({4, 5, 6, 7});
+    REQUIRE(v.value().size() == 4U);
+    REQUIRE(v.value()[3] == 7);
+  }
+  SECTION("non movable") {
+    static_assert(!std::is_move_constructible<optional<std::atomic<int>>>::value, "atomic is movable");
+    optional<std::atomic<int>> a{std::in_place, 5};
+    REQUIRE(a.value().load() == 5);
+    a.emplace(6);
+    REQUIRE(a.value().load() == 6);
+  }
+}
+
+Tracked make_tracked()
+{
+  return Tracked(11);
+}
+
+TEST_CASE("from invoke", "[optional]") {
+  SECTION("constructor") {
+    Tracked::reset();
+    {
+      optional<Tracked> t{std::from_invoke, make_tracked};
+      REQUIRE(t.value().value == 11);
+      REQUIRE(Tracked::moved__ == 0U);
+      REQUIRE(Tracked::destructed__ == 0U);
+    }
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("constructor with lambda") {
+    Tracked::reset();
+    optional<Tracked> t{std::from_invoke, [] { return Tracked(); }};
+    REQUIRE(t.has_value());
+    REQUIRE(Tracked::constructed__ == 1U);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 0U);
+  }
+  SECTION("emplace_with into empty") {
+    Tracked::reset();
+    optional<Tracked> t;
+    Tracked & r = t.emplace_with(make_tracked);
+    REQUIRE(&r == &*t);
+    REQUIRE(r.value == 11);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 0U);
+  }
+  SECTION("emplace_with over a value") {
+    optional<Tracked> t{std::in_place, 1};
+    Tracked::reset();
+    t.emplace_with(make_tracked);
+    REQUIRE(t.value().value == 11);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 1U);
+  }
+  SECTION("other layouts") {
+    optional<Fd> fd{std::from_invoke, [] { return Fd(4); }};
+    REQUIRE(fd.value().fd == 4);
+    fd.emplace_with([] { return Fd(5); });
+    REQUIRE(fd.value().fd == 5);
+    optional<Padded_64_32> p;
+    p.emplace_with([] { return Padded_64_32(1, 2); });
+    REQUIRE(p.value().b() == 2);
+    optional<Stateless_Functor> f;
+    f.emplace_with([] { return Stateless_Functor(); });
+    REQUIRE(f.has_value());
+  }
+}
+
+TEST_CASE("value_or", "[optional]") {
+  SECTION("values") {
+    static_assert(optional<int>().value_or(3) == 3, "constexpr empty");
+    static_assert(optional<int>(1).value_or(3) == 1, "constexpr engaged");
+    const optional<long> l{2};
+    REQUIRE(l.value_or(3) == 2L);
+    REQUIRE(optional<Fd>().value_or(Fd(5)).fd == 5);
+    REQUIRE(optional<double>().value_or(1) == 1.0);
+  }
+  SECTION("engaged never touches the default") {
+    optional<Tracked> t{std::in_place, 1};
+    Tracked fallback{2};
+    Tracked::reset();
+    Tracked v = std::move(t).value_or(std::move(fallback));
+    REQUIRE(v.value == 1);
+    REQUIRE(fallback.value == 2);
+    REQUIRE(Tracked::moved__ == 1U);
+    REQUIRE(Tracked::constructed__ == 0U);
+  }
+  SECTION("empty converts the default") {
+    optional<Tracked> t;
+    Tracked fallback{2};
+    Tracked::reset();
+    Tracked v = std::move(t).value_or(std::move(fallback));
+    REQUIRE(v.value == 2);
+    REQUIRE(fallback.value == 0);
+    REQUIRE(Tracked::moved__ == 1U);
+  }
+  SECTION("copy leaves the value in place") {
+    optional<Tracked_String> s{Tracked_String("kept")};
+    Tracked_String::allocations__ = 0;
+    Tracked_String v = s.value_or("fallback");
+    REQUIRE(v == "kept");
+    REQUIRE(*s == "kept");
+    REQUIRE(Tracked_String::allocations__ == 1U);
+  }
+  SECTION("value_or_else engaged never calls the fallback") {
+    optional<Tracked> t{std::in_place, 1};
+    int calls = 0;
+    Tracked::reset();
+    Tracked v = std::move(t).value_or_else([&] { ++calls; return Tracked(); });
+    REQUIRE(v.value == 1);
+    REQUIRE(calls == 0);
+    REQUIRE(Tracked::constructed__ == 0U);
+    REQUIRE(Tracked::moved__ == 1U);
+  }
+  SECTION("value_or_else empty builds the fallback once") {
+    optional<Tracked> t;
+    int calls = 0;
+    Tracked::reset();
+    Tracked v = std::move(t).value_or_else([&] { ++calls; return Tracked(); });
+    REQUIRE(calls == 1);
+    REQUIRE(Tracked::constructed__ == 1U);
+    REQUIRE(v.value == 0);
+  }
+}
+
+optional<int> parse_digit(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  return optional<int>();
+}
+
+optional<int> halve(int x)
+{
+  if (x % 2 == 0)
+  {
+    return x / 2;
+  }
+  return optional<int>();
+}
+
+TEST_CASE("monadic", "[optional]") {
+  SECTION("transform") {
+    optional<int> x{4};
+    optional<long> y = x.transform([](int i) { return i * 2L; });
+    REQUIRE(y.value() == 8L);
+    optional<int> none;
+    REQUIRE(!none.transform([](int i) { return i * 2L; }).has_value());
+    auto by_ref = [](const int &) -> const double & { static double d = 1.5; return d; };
+    auto d = x.transform(by_ref);
+    static_assert(std::is_same<optional<double>, decltype(d)>::value, "result is a value type");
+    REQUIRE(d.value() == 1.5);
+  }
+  SECTION("transform chain builds no intermediate values") {
+    optional<Tracked> t{std::in_place, 1};
+    Tracked::reset();
+    auto r = t
+      .transform([](const Tracked & x) { return Tracked(x.value + 1); })
+      .transform([](const Tracked & x) { return Tracked(x.value * 3); })
+      .transform([](const Tracked & x) { return Tracked(x.value - 1); });
+    REQUIRE(r.value().value == 5);
+    REQUIRE(Tracked::moved__ == 0U);
+    REQUIRE(Tracked::destructed__ == 2U);
+  }
+  SECTION("value category is forwarded") {
+    optional<Tracked> t{std::in_place, 1};
+    Tracked::reset();
+    auto moved = std::move(t).transform([](Tracked && x) { return Tracked(std::move(x)); });
+    REQUIRE(moved.value().value == 1);
+    REQUIRE(t.value().value == 0);
+    REQUIRE(Tracked::moved__ == 1U);
+    const optional<int> c{1};
+    REQUIRE(c.transform([](const int &) { return true; }).value());
+    REQUIRE(std::move(c).transform([](const int &&) { return true; }).value());
+  }
+  SECTION("and_then") {
+    auto digit = optional<char>('8').and_then([](char c) { return parse_digit(c); });
+    REQUIRE(digit.value() == 8);
+    REQUIRE(digit.and_then(halve).and_then(halve).and_then(halve).value() == 1);
+    REQUIRE(!digit.and_then(halve).and_then(halve).and_then(halve).and_then(halve).has_value());
+    REQUIRE(!optional<char>('x').and_then([](char c) { return parse_digit(c); }).has_value());
+    REQUIRE(!optional<char>().and_then([](char c) { return parse_digit(c); }).has_value());
+  }
+  SECTION("or_else") {
+    int calls = 0;
+    auto fallback = [&] { ++calls; return optional<int>(9); };
+    REQUIRE(optional<int>(1).or_else(fallback).value() == 1);
+    REQUIRE(calls == 0);
+    REQUIRE(optional<int>().or_else(fallback).value() == 9);
+    REQUIRE(calls == 1);
+    optional<Move_Only> m{Move_Only()};
+    REQUIRE(std::move(m).or_else([] { return optional<Move_Only>(); }).has_value());
+    auto t = optional<Tracked>().or_else([] { return optional<Tracked>(std::in_place, 2); });
+    static_assert(std::is_same<optional<Tracked>, decltype(t)>::value, "std::optional<T>, not its base");
+    REQUIRE(t.value().value == 2);
+  }
+  SECTION("value_or_else is lazy") {
+    int calls = 0;
+    auto fallback = [&] { ++calls; return 7; };
+    REQUIRE(optional<int>(1).value_or_else(fallback) == 1);
+    REQUIRE(calls == 0);
+    REQUIRE(optional<int>().value_or_else(fallback) == 7);
+    REQUIRE(calls == 1);
+    optional<Tracked> t{std::in_place, 3};
+    Tracked::reset();
+    Tracked v = std::move(t).value_or_else([] { return Tracked(); });
+    REQUIRE(v.value == 3);
+    REQUIRE(Tracked::moved__ == 1U);
+    REQUIRE(Tracked::constructed__ == 0U);
+  }
+}
+
+struct Counted_String
+{
+  static int constructions__;
+
+  Counted_String(const char * s) : s_(s) { ++constructions__; }
+
+  friend bool operator==(const Counted_String & a, const char * b) { return a.s_ == b; }
+  friend bool operator==(const char * a, const Counted_String & b) { return a == b.s_; }
+  friend bool operator!=(const Counted_String & a, const char * b) { return a.s_ != b; }
+  friend bool operator<(const Counted_String & a, const char * b) { return a.s_ < b; }
+
+  std::string s_;
+};
+
+int Counted_String::constructions__ = 0;
+
+TEST_CASE("comparisons", "[optional]") {
+  const optional<int> empty;
+  const optional<int> one{1};
+  const optional<int> two{2};
+
+  SECTION("optional and optional") {
+    REQUIRE(empty == optional<int>());
+    REQUIRE(one == optional<long>(1));
+    REQUIRE(empty != one);
+    REQUIRE(one != two);
+    REQUIRE(empty < one);
+    REQUIRE(one < two);
+    REQUIRE(!(one < empty));
+    REQUIRE(!(empty < optional<int>()));
+    REQUIRE(empty <= optional<int>());
+    REQUIRE(one <= one);
+    REQUIRE(!(two <= one));
+    REQUIRE(two > one);
+    REQUIRE(one > empty);
+    REQUIRE(!(empty > empty));
+    REQUIRE(two >= two);
+    REQUIRE(empty >= empty);
+    REQUIRE(!(empty >= one));
+  }
+  SECTION("optional and nullopt") {
+    REQUIRE(empty == std::nullopt);
+    REQUIRE(std::nullopt == empty);
+    REQUIRE(one != std::nullopt);
+    REQUIRE(std::nullopt != one);
+    REQUIRE(!(one < std::nullopt));
+    REQUIRE(std::nullopt < one);
+    REQUIRE(!(std::nullopt < empty));
+    REQUIRE(empty <= std::nullopt);
+    REQUIRE(std::nullopt <= one);
+    REQUIRE(one > std::nullopt);
+    REQUIRE(!(std::nullopt > empty));
+    REQUIRE(one >= std::nullopt);
+    REQUIRE(std::nullopt >= empty);
+    REQUIRE(!(std::nullopt >= one));
+  }
+  SECTION("optional and value") {
+    REQUIRE(one == 1);
+    REQUIRE(1 == one);
+    REQUIRE(!(empty == 0));
+    REQUIRE(empty != 0);
+    REQUIRE(0 != empty);
+    REQUIRE(empty < 0);
+    REQUIRE(!(0 < empty));
+    REQUIRE(one < 2L);
+    REQUIRE(one <= 1);
+    REQUIRE(empty <= -5);
+    REQUIRE(!(0 <= empty));
+    REQUIRE(two > 1);
+    REQUIRE(0 > empty);
+    REQUIRE(!(empty > 0));
+    REQUIRE(two >= 2);
+    REQUIRE(3 >= two);
+    REQUIRE(-5 >= empty);
+  }
+  SECTION("no temporaries") {
+    optional<Counted_String> s{"text"};
+    optional<Counted_String> none;
+    Counted_String::constructions__ = 0;
+    REQUIRE(s == "text");
+    REQUIRE("text" == s);
+    REQUIRE(none != "text");
+    REQUIRE(s < "zzz");
+    REQUIRE(Counted_String::constructions__ == 0);
+
+    optional<std::string> str{"abc"};
+    REQUIRE(str == "abc");
+    REQUIRE(str < "abd");
+  }
+  SECTION("constexpr") {
+    constexpr optional<int> c{3};
+    static_assert(c == 3, "");
+    static_assert(c != std::nullopt, "");
+    static_assert(c > optional<int>(), "");
+    static_assert(optional<int>() < c, "");
+  }
+  SECTION("nested and references") {
+    optional<optional<int>> inner_empty{optional<int>()};
+    REQUIRE(inner_empty != std::nullopt);
+    REQUIRE(*inner_empty == std::nullopt);
+    int x = 1;
+    optional<int&> r{x};
+    REQUIRE(r == one);
+    REQUIRE(r == 1);
+    REQUIRE(optional<int&>() == empty);
+  }
+}
+
+TEST_CASE("hash", "[optional]") {
+  REQUIRE(std::hash<optional<int>>()(optional<int>{42}) == std::hash<int>()(42));
+  REQUIRE(std::hash<optional<double>>()(optional<double>{1.5}) == std::hash<double>()(1.5));
+  REQUIRE(std::hash<optional<std::string>>()(optional<std::string>{"key"}) == std::hash<std::string>()("key"));
+  REQUIRE(std::hash<optional<const int>>()(optional<const int>{7}) == std::hash<int>()(7));
+  std::string key = "key";
+  REQUIRE(std::hash<optional<std::string&>>()(optional<std::string&>{key}) == std::hash<std::string>()("key"));
+  REQUIRE(std::hash<optional<const std::string&>>()(optional<const std::string&>{key}) == std::hash<std::string>()("key"));
+  REQUIRE(std::hash<optional<int&>>()(optional<int&>()) == std::hash<optional<int>>()(optional<int>()));
+
+  std::size_t empty = std::hash<optional<int>>()(optional<int>());
+  REQUIRE(empty == std::hash<optional<std::string>>()(optional<std::string>()));
+  REQUIRE(empty != std::hash<optional<int>>()(optional<int>{0}));
+
+  std::unordered_set<optional<int>> keys{optional<int>(), 1, 2, optional<int>()};
+  REQUIRE(keys.size() == 3U);
+  REQUIRE(keys.count(optional<int>()) == 1U);
+  REQUIRE(keys.count(2) == 1U);
+}
+
 TEST_CASE("swap", "[optional]") {
   SECTION("neither set")
   {
@@ -182,6 +1344,7 @@ TEST_CASE("swap", "[optional]") {
     REQUIRE(Tracked::constructed__ == 0U);
     REQUIRE(Tracked::destructed__ == 1U);
     REQUIRE(Tracked::moved__ == 3U);
+    REQUIRE(Tracked::move_assigned__ == 2U);
   }
   SECTION("lhs set")
   {
@@ -195,6 +1358,7 @@ TEST_CASE("swap", "[optional]") {
     REQUIRE(Tracked::constructed__ == 0U);
     REQUIRE(Tracked::destructed__ == 1U);
     REQUIRE(Tracked::moved__ == 1U);
+    REQUIRE(Tracked::move_assigned__ == 0U);
   }
   SECTION("rhs set")
   {
@@ -208,5 +1372,156 @@ TEST_CASE("swap", "[optional]") {
     REQUIRE(Tracked::constructed__ == 0U);
     REQUIRE(Tracked::destructed__ == 1U);
     REQUIRE(Tracked::moved__ == 1U);
+    REQUIRE(Tracked::move_assigned__ == 0U);
+  }
+  SECTION("self swap")
+  {
+    optional<Tracked> v1{Tracked(1)};
+    Tracked::reset();
+    v1.swap(v1);
+    REQUIRE(v1.value().value == 1U);
+    REQUIRE(Tracked::destructed__ == 1U);
+    REQUIRE(Tracked::moved__ == 3U);
+  }
+  SECTION("trivially copyable")
+  {
+    static_assert(noexcept(std::declval<optional<int>&>().swap(std::declval<optional<int>&>())), "noexcept");
+    optional<int> a{1};
+    optional<int> b;
+    a.swap(b);
+    REQUIRE(!a.has_value());
+    REQUIRE(b.value() == 1);
+    b.swap(a);
+    REQUIRE(a.value() == 1);
+    REQUIRE(!b.has_value());
+    a.swap(a);
+    REQUIRE(a.value() == 1);
+    optional<int> c{2};
+    a.swap(c);
+    REQUIRE(a.value() == 2);
+    REQUIRE(c.value() == 1);
+  }
+  SECTION("trivially copyable layouts")
+  {
+    optional<Padded_64_32> p{Padded_64_32(1, 2)};
+    optional<Padded_64_32> q;
+    p.swap(q);
+    REQUIRE(!p.has_value());
+    REQUIRE(q.value().b() == 2);
+
+    optional<Fd> f{Fd(3)};
+    optional<Fd> g;
+    g.swap(f);
+    REQUIRE(!f.has_value());
+    REQUIRE(g.value().fd == 3);
+
+    optional<optional<int>> outer_empty;
+    optional<optional<int>> inner_empty{optional<int>()};
+    outer_empty.swap(inner_empty);
+    REQUIRE(outer_empty.has_value());
+    REQUIRE(!outer_empty.value().has_value());
+    REQUIRE(!inner_empty.has_value());
+  }
+}
+
+optional<Tracked> halve_tracked(const Tracked & x)
+{
+  return x.value % 2 ? optional<Tracked>() : optional<Tracked>(std::in_place, x.value / 2);
+}
+
+//! Built from a Tracked, explicitly, so optional<Wraps_Tracked> converts from optional<Tracked>
+struct Wraps_Tracked
+{
+  explicit Wraps_Tracked(const Tracked & t) : tracked(t) {}
+  explicit Wraps_Tracked(Tracked && t) : tracked(std::move(t)) {}
+  Tracked tracked;
+};
+
+TEST_CASE("lifecycle budgets", "[optional]") {
+  const optional<Tracked> engaged{std::in_place, 2};
+  const optional<Tracked> empty;
+  optional<Tracked> source{std::in_place, 1};
+  optional<Tracked> target{std::in_place, 1};
+  optional<Tracked> blank;
+  Tracked value{3};
+  optional<int> i{3};
+
+  SECTION("constructors") {
+    REQUIRE_COST(budget(), optional<Tracked> t; (void)t);
+    REQUIRE_COST(budget(), optional<Tracked> t{std::nullopt}; (void)t);
+    REQUIRE_COST(budget().copies(1).allocations(1), optional<Tracked> t{engaged}; (void)t);
+    REQUIRE_COST(budget(), optional<Tracked> t{empty}; (void)t);
+    REQUIRE_COST(budget().moves(1), optional<Tracked> t{std::move(source)}; (void)t);
+    REQUIRE_COST(budget().copies(1).allocations(1), optional<Tracked> t{value}; (void)t);
+    REQUIRE_COST(budget().moves(1), optional<Tracked> t{std::move(value)}; (void)t);
+    REQUIRE_COST(budget().allocations(1), optional<Tracked> t{std::in_place, 4}; (void)t);
+    REQUIRE_COST(budget().allocations(1), optional<Tracked> t{std::from_invoke, [] { return Tracked(5); }}; (void)t);
+  }
+  SECTION("converting constructors") {
+    optional<int> none;
+    REQUIRE_COST(budget().allocations(1), optional<Tracked> t = i; (void)t);
+    REQUIRE_COST(budget().allocations(1), optional<Tracked> t = std::move(i); (void)t);
+    REQUIRE_COST(budget(), optional<Tracked> t = none; (void)t);
+    REQUIRE_COST(budget().copies(1).allocations(1), optional<Wraps_Tracked> t{engaged}; (void)t);
+    REQUIRE_COST(budget().moves(1), optional<Wraps_Tracked> t{std::move(source)}; (void)t);
+    REQUIRE_COST(budget(), optional<Wraps_Tracked> t{empty}; (void)t);
+    static_assert(std::is_convertible<const optional<int> &, optional<Tracked>>::value, "implicit");
+    static_assert(std::is_convertible<optional<int> &&, optional<Tracked>>::value, "implicit");
+    static_assert(!std::is_convertible<const optional<Tracked> &, optional<Wraps_Tracked>>::value, "explicit");
+    static_assert(!std::is_convertible<optional<Tracked> &&, optional<Wraps_Tracked>>::value, "explicit");
+    optional<long> l{i};
+    REQUIRE(*l == 3);
+    optional<Wraps_Tracked> w{engaged};
+    REQUIRE(w.value().tracked.value == 2);
+  }
+  SECTION("assignment") {
+    REQUIRE_COST(budget().copies(1), target = engaged);
+    REQUIRE_COST(budget().copies(1).allocations(1), blank = engaged);
+    REQUIRE_COST(budget().moves(1), target = std::move(source));
+    REQUIRE_COST(budget().copies(1), target = value);
+    REQUIRE_COST(budget().moves(1), target = std::move(value));
+    REQUIRE_COST(budget(), target = empty);
+    REQUIRE_COST(budget().moves(1), target = std::move(blank));
+    REQUIRE_COST(budget(), blank = std::nullopt);
+    REQUIRE_COST(budget().allocations(1), blank = i);
+  }
+  SECTION("converting assignment into a value goes through one temporary") {
+    REQUIRE_COST(budget().moves(1).allocations(1), target = i);
+  }
+  SECTION("emplace") {
+    REQUIRE_COST(budget().allocations(1), blank.emplace(3));
+    REQUIRE_COST(budget().allocations(1), target.emplace(3));
+    REQUIRE_COST(budget().allocations(1), blank.emplace_with([] { return Tracked(3); }));
+  }
+  SECTION("swap") {
+    REQUIRE_COST(budget().moves(3), source.swap(target));
+    REQUIRE_COST(budget().moves(1), source.swap(blank));
+    optional<Tracked> other;
+    REQUIRE_COST(budget(), other.swap(source));
+  }
+  SECTION("monadic") {
+    REQUIRE_COST(budget().allocations(1),
+      auto r = engaged.transform([](const Tracked & x) { return Tracked(x.value + 1); }); (void)r);
+    REQUIRE_COST(budget().moves(1),
+      auto r = std::move(source).transform([](Tracked && x) { return Tracked(std::move(x)); }); (void)r);
+    REQUIRE_COST(budget().allocations(1), auto r = engaged.and_then(halve_tracked); (void)r);
+    REQUIRE_COST(budget().copies(1).allocations(1),
+      auto r = engaged.or_else([] { return optional<Tracked>(); }); (void)r);
+    REQUIRE_COST(budget().moves(1),
+      auto r = std::move(target).or_else([] { return optional<Tracked>(); }); (void)r);
+    REQUIRE_COST(budget().allocations(1),
+      auto r = empty.or_else([] { return optional<Tracked>(std::in_place, 2); }); (void)r);
+    REQUIRE_COST(budget().moves(1), Tracked r = std::move(source).value(); (void)r);
+    REQUIRE_COST(budget(), const Tracked & r = engaged.value(); (void)r);
+  }
+  SECTION("value_or") {
+    REQUIRE_COST(budget().copies(1).allocations(1), Tracked r = engaged.value_or(0); (void)r);
+    REQUIRE_COST(budget().moves(1), Tracked r = std::move(source).value_or(0); (void)r);
+    REQUIRE_COST(budget().allocations(1), Tracked r = empty.value_or(0); (void)r);
+    REQUIRE_COST(budget().allocations(1), Tracked r = empty.value_or_else([] { return Tracked(2); }); (void)r);
+  }
+  SECTION("or_else returns std::optional<T>, not its base") {
+    auto r = engaged.or_else([] { return optional<Tracked>(); });
+    static_assert(std::is_same<optional<Tracked>, decltype(r)>::value, "std::optional<T>");
   }
 }
@@ -0,0 +1,211 @@
+#include <catch.hpp>
+#include <optional_vector.hpp>
+#include <string>
+#include <vector>
+
+struct Counted
+{
+  Counted(int v) : value(v) { ++alive__; }
+  Counted(const Counted & x) : value(x.value) { ++alive__; }
+  Counted(Counted && x) noexcept : value(x.value) { ++alive__; }
+  Counted & operator=(const Counted &) = default;
+  ~Counted() { --alive__; }
+
+  int value;
+  static int alive__;
+};
+int Counted::alive__(0);
+
+TEST_CASE("layout", "[optional_vector]") {
+  static_assert(std::is_same<std::optional<double&>, std::optional_vector<double>::reference>::value, "reference");
+  static_assert(std::is_same<std::optional<const double&>, std::optional_vector<double>::const_reference>::value, "const_reference");
+
+  std::optional_vector<std::int64_t> v(100);
+  REQUIRE(v.size() == 100U);
+  REQUIRE(v.capacity() == 100U);
+  for (std::size_t i = 0; i != v.size(); ++i)
+  {
+    REQUIRE(!v.has_value(i));
+    REQUIRE(v.data()[i] == 0);
+  }
+  REQUIRE(v.bitmap()[0] == 0U);
+  REQUIRE(v.bitmap()[1] == 0U);
+  // 8 bytes of value and one bit per element, against 16 for optional<int64_t>
+  static_assert(sizeof(std::optional<std::int64_t>) == 2 * sizeof(std::int64_t), "optional<int64_t>");
+}
+
+TEST_CASE("push_back", "[optional_vector]") {
+  std::optional_vector<int> v;
+  REQUIRE(v.empty());
+  v.push_back(1);
+  v.push_back(std::nullopt);
+  v.push_back(std::optional<int>(3));
+  v.push_back(std::optional<int>());
+  const std::optional<int> five{5};
+  v.push_back(five);
+  int six = 6;
+  v.push_back(std::optional<int&>(six));
+  REQUIRE(v.emplace_back(7) == 7);
+  REQUIRE(v.size() == 7U);
+
+  REQUIRE(v[0].value() == 1);
+  REQUIRE(!v[1]);
+  REQUIRE(*v[2] == 3);
+  REQUIRE(!v[3].has_value());
+  REQUIRE(v.value(4) == 5);
+  REQUIRE(v.value(5) == 6);
+  REQUIRE(v.value(6) == 7);
+  REQUIRE_THROWS_AS(v.value(1), std::bad_optional_access);
+  REQUIRE(v.bitmap()[0] == 0x75U);
+}
+
+TEST_CASE("element access", "[optional_vector]") {
+  std::optional_vector<int> v{1, std::nullopt, 3};
+  *v[0] = 10;
+  REQUIRE(v.value(0) == 10);
+  v.emplace(1, 2);
+  REQUIRE(v.value(1) == 2);
+  v.reset(0);
+  REQUIRE(!v.has_value(0));
+  v.reset(0);
+  REQUIRE(!v.has_value(0));
+  const std::optional_vector<int> & c = v;
+  REQUIRE(&*c[2] == &v.value(2));
+  v.pop_back();
+  REQUIRE(v.size() == 2U);
+  REQUIRE(v.bitmap()[0] == 0x2U);
+}
+
+TEST_CASE("growth", "[optional_vector]") {
+  std::optional_vector<std::string> v;
+  for (int i = 0; i != 1000; ++i)
+  {
+    if (i % 3)
+    {
+      v.push_back(std::to_string(i));
+    }
+    else
+    {
+      v.push_back(std::nullopt);
+    }
+  }
+  REQUIRE(v.size() == 1000U);
+  for (int i = 0; i != 1000; ++i)
+  {
+    REQUIRE(v.has_value(i) == (i % 3 != 0));
+    if (i % 3)
+    {
+      REQUIRE(*v[i] == std::to_string(i));
+    }
+  }
+
+  SECTION("value aliasing an element survives growth") {
+    std::optional_vector<std::string> w;
+    w.push_back(std::string(64, 'x'));
+    while (w.size() != w.capacity())
+    {
+      w.push_back(std::nullopt);
+    }
+    w.push_back(*w[0]);
+    REQUIRE(*w[w.size() - 1] == std::string(64, 'x'));
+  }
+}
+
+TEST_CASE("resize", "[optional_vector]") {
+  std::optional_vector<int> v;
+  for (int i = 0; i != 130; ++i)
+  {
+    v.push_back(i);
+  }
+  v.resize(65);
+  REQUIRE(v.size() == 65U);
+  REQUIRE(v.bitmap()[0] == ~std::uint64_t(0));
+  REQUIRE(v.bitmap()[1] == 1U);
+  REQUIRE(v.bitmap()[2] == 0U);
+  v.resize(200);
+  REQUIRE(v.size() == 200U);
+  REQUIRE(v.value(64) == 64);
+  REQUIRE(!v.has_value(65));
+  REQUIRE(!v.has_value(199));
+  v.clear();
+  REQUIRE(v.empty());
+  REQUIRE(v.bitmap()[0] == 0U);
+
+  // growing one element at a time reallocates geometrically
+  std::optional_vector<int> w;
+  std::size_t reallocations = 0;
+  for (std::size_t n = 1; n <= 1000; ++n)
+  {
+    std::size_t capacity = w.capacity();
+    w.resize(n);
+    reallocations += w.capacity() != capacity;
+  }
+  REQUIRE(reallocations <= 11U);
+}
+
+TEST_CASE("lifetime", "[optional_vector]") {
+  Counted::alive__ = 0;
+  {
+    std::optional_vector<Counted> v;
+    for (int i = 0; i != 100; ++i)
+    {
+      v.emplace_back(i);
+      v.push_back(std::nullopt);
+    }
+    REQUIRE(Counted::alive__ == 100);
+    v.reset(0);
+    REQUIRE(Counted::alive__ == 99);
+    v.emplace(1, 1);
+    v.emplace(2, 2);
+    REQUIRE(Counted::alive__ == 100);
+
+    std::optional_vector<Counted> copy(v);
+    REQUIRE(Counted::alive__ == 200);
+    REQUIRE(copy.value(1).value == 1);
+    REQUIRE(copy.value(2).value == 2);
+    REQUIRE(!copy.has_value(0));
+
+    std::optional_vector<Counted> moved(std::move(copy));
+    REQUIRE(Counted::alive__ == 200);
+    REQUIRE(copy.empty());
+
+    v.resize(10);
+    REQUIRE(Counted::alive__ == 105);
+    moved = v;
+    REQUIRE(Counted::alive__ == 10);
+    moved = std::optional_vector<Counted>();
+    REQUIRE(Counted::alive__ == 5);
+  }
+  REQUIRE(Counted::alive__ == 0);
+}
+
+TEST_CASE("iteration", "[optional_vector]") {
+  std::optional_vector<int> v{1, std::nullopt, 3, std::nullopt, 5};
+  int sum = 0;
+  int empty = 0;
+  for (std::optional<int&> x : v)
+  {
+    if (x)
+    {
+      sum += *x;
+      *x = 0;
+    }
+    else
+    {
+      ++empty;
+    }
+  }
+  REQUIRE(sum == 9);
+  REQUIRE(empty == 2);
+
+  const std::optional_vector<int> & c = v;
+  std::vector<bool> engaged;
+  for (auto it = c.begin(); it != c.end(); ++it)
+  {
+    engaged.push_back((*it).has_value());
+    REQUIRE((!*it || **it == 0));
+  }
+  REQUIRE(engaged == (std::vector<bool>{true, false, true, false, true}));
+  std::optional_vector<int>::const_iterator first = v.begin();
+  REQUIRE(first == c.begin());
+}
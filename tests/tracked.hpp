@@ -0,0 +1,170 @@
+#pragma once
+#include <catch.hpp>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+#include <sys/types.h>
+
+/*! A payload that counts its special member calls and heap allocations,
+    so tests can put a budget on what an optional operation costs:
+
+      REQUIRE_COST(budget().moves(1), a = std::move(b));
+
+    Every value owns a heap allocation: moves steal it, copies make a new
+    one, and copy assignment reuses the target's if it has one.
+*/
+template<class = void>
+struct tracked_counters_
+{
+  static ssize_t constructed__;   //!< default constructions only
+  static ssize_t copied__;        //!< copy constructions and copy assignments
+  static ssize_t moved__;         //!< move constructions and move assignments
+  static ssize_t copy_assigned__;
+  static ssize_t move_assigned__;
+  static ssize_t destructed__;
+  static ssize_t allocations__;
+
+  static void reset()
+  {
+    constructed__ = 0U;
+    copied__ = 0U;
+    moved__ = 0U;
+    copy_assigned__ = 0U;
+    move_assigned__ = 0U;
+    destructed__ = 0U;
+    allocations__ = 0U;
+  }
+};
+
+template<class V> ssize_t tracked_counters_<V>::constructed__(0);
+template<class V> ssize_t tracked_counters_<V>::copied__(0);
+template<class V> ssize_t tracked_counters_<V>::moved__(0);
+template<class V> ssize_t tracked_counters_<V>::copy_assigned__(0);
+template<class V> ssize_t tracked_counters_<V>::move_assigned__(0);
+template<class V> ssize_t tracked_counters_<V>::destructed__(0);
+template<class V> ssize_t tracked_counters_<V>::allocations__(0);
+
+struct Tracked : tracked_counters_<>
+{
+  Tracked()
+    : value()
+    , heap_(allocate())
+  {
+    ++constructed__;
+  }
+
+  Tracked(int x)
+    : value(x)
+    , heap_(allocate())
+  {
+  }
+
+  Tracked(const Tracked & x)
+    : value(x.value)
+    , heap_(allocate())
+  {
+    ++copied__;
+  }
+
+  Tracked(Tracked && x)
+    : value(x.value)
+    , heap_(x.heap_)
+  {
+    x.value = 0;
+    x.heap_ = nullptr;
+    ++moved__;
+  }
+
+  Tracked & operator=(const Tracked & x)
+  {
+    value = x.value;
+    if (!heap_)
+    {
+      heap_ = allocate();
+    }
+    ++copied__;
+    ++copy_assigned__;
+    return *this;
+  }
+
+  Tracked & operator=(Tracked && x)
+  {
+    value = x.value;
+    x.value = 0;
+    std::swap(heap_, x.heap_);
+    ++moved__;
+    ++move_assigned__;
+    return *this;
+  }
+
+  ~Tracked() {
+    delete heap_;
+    ++destructed__;
+  }
+
+  int value;
+
+  private:
+  static int * allocate()
+  {
+    ++allocations__;
+    return new int();
+  }
+
+  int * heap_;
+};
+
+//! What Tracked values went through during cost_of()
+struct lifecycle_cost
+{
+  ssize_t copies;
+  ssize_t moves;
+  ssize_t allocations;
+};
+
+//! Upper bounds for a lifecycle_cost, zero unless given
+class budget
+{
+  public:
+  budget copies(ssize_t n) const { budget b = *this; b.copies_ = n; return b; }
+  budget moves(ssize_t n) const { budget b = *this; b.moves_ = n; return b; }
+  budget allocations(ssize_t n) const { budget b = *this; b.allocations_ = n; return b; }
+
+  friend bool operator<=(const lifecycle_cost & c, const budget & b)
+  {
+    return c.copies <= b.copies_ && c.moves <= b.moves_ && c.allocations <= b.allocations_;
+  }
+
+  friend std::ostream & operator<<(std::ostream & os, const budget & b)
+  {
+    return os << "{copies " << b.copies_ << ", moves " << b.moves_
+              << ", allocations " << b.allocations_ << "}";
+  }
+
+  private:
+  ssize_t copies_ = 0;
+  ssize_t moves_ = 0;
+  ssize_t allocations_ = 0;
+};
+
+inline std::ostream & operator<<(std::ostream & os, const lifecycle_cost & c)
+{
+  return os << "{copies " << c.copies << ", moves " << c.moves
+            << ", allocations " << c.allocations << "}";
+}
+
+template<class F>
+lifecycle_cost cost_of(F && f)
+{
+  Tracked::reset();
+  f();
+  return lifecycle_cost{Tracked::copied__, Tracked::moved__, Tracked::allocations__};
+}
+
+//! Runs the statements after limit and requires their cost_of() within it
+#define REQUIRE_COST(limit, ...) \
+  do { \
+    const lifecycle_cost cost_ = cost_of([&] { __VA_ARGS__; }); \
+    INFO(#__VA_ARGS__); \
+    REQUIRE(cost_ <= (limit)); \
+  } while (false)